@@ -145,6 +145,7 @@ void Board<Magic>::initialize_board(string fen){
     for(int i = 6; i < 12; i++){
         white_pieces |= board[i];
     }
+    key = zob_key(*zobrist_table, board, curr_player, castling_rights, en_passant);
     // cout << (white_pieces) << ' ';
     // cout << (black_pieces) << ' ';
     // cout << (board[11] | board[5]) << ' ';
@@ -401,12 +402,241 @@ void Board<Magic>::do_move(Bitboard board[], Move move, Color color, CastlingRig
     }
 }
 
+/// @brief Take back a move made with do_move in the given board, only the bitboards are restored
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param board bitboard array representing the board after the move
+/// @param move move to take back
+/// @param color player that did the move
+template <typename Magic>
+void Board<Magic>::undo_move(Bitboard board[], Move move, Color color){
+    if(move.from == 255 && move.to == 255) return;
+
+    if(in_range(move.get_en_passant(), 16, 47)){
+        board[move.piece] &= ~(1ULL << move.to);
+        board[move.piece] |= (1ULL << move.from);
+
+        board[move.capture_piece] |= (1ULL << (move.get_en_passant()+(color ? 8 : -8)));
+    }else if(move.capture_piece != 255 && (move.promotion_piece == 0 || move.promotion_piece == 255)){
+        board[move.piece] &= ~(1ULL << move.to);
+        board[move.piece] |= (1ULL << move.from);
+
+        board[move.capture_piece] |= (1ULL << move.to);
+    }else if(move.promotion_piece != 255){
+        board[move.promotion_piece+(color*6)] &= ~(1ULL << move.to);
+        board[move.piece] |= (1ULL << move.from);
+
+        if(move.capture_piece != 255){
+            board[move.capture_piece] |= (1ULL << move.to);
+        }
+    }else if(move.get_castling() == 1){
+        board[move.piece] &= ~(1ULL << move.to);
+        board[move.piece] |= (1ULL << move.from);
+
+        board[(color ? WHITE_ROOK-1 : BLACK_ROOK-1)] &= ~(FILE_F & (color ? RANK_1 : RANK_8));
+        board[(color ? WHITE_ROOK-1 : BLACK_ROOK-1)] |= (FILE_H & (color ? RANK_1 : RANK_8));
+    }else if(move.get_castling() == 2){
+        board[move.piece] &= ~(1ULL << move.to);
+        board[move.piece] |= (1ULL << move.from);
+
+        board[(color ? WHITE_ROOK-1 : BLACK_ROOK-1)] &= ~(FILE_D & (color ? RANK_1 : RANK_8));
+        board[(color ? WHITE_ROOK-1 : BLACK_ROOK-1)] |= (FILE_A & (color ? RANK_1 : RANK_8));
+    }else{
+        board[move.piece] &= ~(1ULL << move.to);
+        board[move.piece] |= (1ULL << move.from);
+    }
+}
+
+/// @brief Update the occupancy bitboards with the squares a move touches.
+/// The update is a xor, so calling it again with the same move takes it back
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param occupancy occupancy bitboards by color, index NO_COLOR holds every piece
+/// @param move move made or taken back
+/// @param color player doing the move
+template <typename Magic>
+void Board<Magic>::move_occupancy(Bitboard occupancy[], Move move, Color color){
+    if(move.from == 255 && move.to == 255) return;
+    Bitboard from = (1ULL << move.from), to = (1ULL << move.to);
+
+    occupancy[color] ^= from | to;
+    if(in_range(move.get_en_passant(), 16, 47)){
+        Bitboard captured = (1ULL << (move.get_en_passant()+(color ? 8 : -8)));
+        occupancy[color^1] ^= captured;
+        occupancy[NO_COLOR] ^= from | to | captured;
+    }else if(move.capture_piece != 255){
+        occupancy[color^1] ^= to;
+        occupancy[NO_COLOR] ^= from;
+    }else{
+        occupancy[NO_COLOR] ^= from | to;
+        if(move.get_castling() == 1 || move.get_castling() == 2){
+            Bitboard rook = (FILE_H | FILE_F) & (color ? RANK_1 : RANK_8);
+            if(move.get_castling() == 2){
+                rook = (FILE_A | FILE_D) & (color ? RANK_1 : RANK_8);
+            }
+            occupancy[color] ^= rook;
+            occupancy[NO_COLOR] ^= rook;
+        }
+    }
+}
+
+/// @brief Compute the occupancy bitboards from the bitboard array
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param board bitboard array representing the board
+/// @param occupancy occupancy bitboards by color, index NO_COLOR holds every piece
+template <typename Magic>
+void Board<Magic>::compute_occupancy(Bitboard board[], Bitboard occupancy[]){
+    occupancy[BLACK] = occupancy[WHITE] = 0;
+    for(int i = NO_PIECE; i < BLACK_KING; i++){
+        occupancy[BLACK] |= board[i];
+    }
+    for(int i = BLACK_KING; i < WHITE_KING; i++){
+        occupancy[WHITE] |= board[i];
+    }
+    occupancy[NO_COLOR] = occupancy[BLACK] | occupancy[WHITE];
+}
+
+/// @brief Update the mailbox with a move
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param mailbox piece index on each square, 255 for empty squares
+/// @param move move to make
+/// @param color player doing the move
+template <typename Magic>
+void Board<Magic>::move_mailbox(u8 mailbox[], Move move, Color color){
+    if(move.from == 255 && move.to == 255) return;
+
+    mailbox[move.from] = 255;
+    if(in_range(move.get_en_passant(), 16, 47)){
+        mailbox[move.get_en_passant()+(color ? 8 : -8)] = 255;
+        mailbox[move.to] = move.piece;
+    }else if(move.promotion_piece != 255 && (move.capture_piece == 255 || move.promotion_piece != 0)){
+        mailbox[move.to] = move.promotion_piece+(color*6);
+    }else{
+        mailbox[move.to] = move.piece;
+        if(move.get_castling() == 1){
+            u8 rook = (color ? WHITE_ROOK-1 : BLACK_ROOK-1);
+            mailbox[(color ? 63 : 7)] = 255;
+            mailbox[(color ? 61 : 5)] = rook;
+        }else if(move.get_castling() == 2){
+            u8 rook = (color ? WHITE_ROOK-1 : BLACK_ROOK-1);
+            mailbox[(color ? 56 : 0)] = 255;
+            mailbox[(color ? 59 : 3)] = rook;
+        }
+    }
+}
+
+/// @brief Take back a move from the mailbox
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param mailbox piece index on each square, 255 for empty squares
+/// @param move move to take back
+/// @param color player that did the move
+template <typename Magic>
+void Board<Magic>::undo_mailbox(u8 mailbox[], Move move, Color color){
+    if(move.from == 255 && move.to == 255) return;
+
+    mailbox[move.from] = move.piece;
+    if(in_range(move.get_en_passant(), 16, 47)){
+        mailbox[move.get_en_passant()+(color ? 8 : -8)] = move.capture_piece;
+        mailbox[move.to] = 255;
+    }else{
+        mailbox[move.to] = move.capture_piece;
+        if(move.get_castling() == 1){
+            mailbox[(color ? 63 : 7)] = (color ? WHITE_ROOK-1 : BLACK_ROOK-1);
+            mailbox[(color ? 61 : 5)] = 255;
+        }else if(move.get_castling() == 2){
+            mailbox[(color ? 56 : 0)] = (color ? WHITE_ROOK-1 : BLACK_ROOK-1);
+            mailbox[(color ? 59 : 3)] = 255;
+        }
+    }
+}
+
+/// @brief Compute the mailbox from the bitboard array
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param board bitboard array representing the board
+/// @param mailbox piece index on each square, 255 for empty squares
+template <typename Magic>
+void Board<Magic>::compute_mailbox(Bitboard board[], u8 mailbox[]){
+    memset(mailbox, 255, 64*sizeof(u8));
+    for(int i = NO_PIECE; i < WHITE_KING; i++){
+        Bitboard bb = board[i];
+        while(bb){
+            mailbox[__builtin_ctzll(bb)] = i;
+            bb &= bb-1;
+        }
+    }
+}
+
+/// @brief Get the zobrist keys of the castling rights and en passant square
+/// @param zobrist_table reference to the Zobrist object
+/// @param crs castling rights
+/// @param eps en passant square
+/// @return xor of the keys
+static u64 zob_state(Zobrist &zobrist_table, CastlingRights crs, u8 eps){
+    u64 h = 0;
+    if(crs & WHITE_OO){
+        h ^= zobrist_table[zobrist_table.black_to_move+1];
+    }
+    if(crs & WHITE_OOO){
+        h ^= zobrist_table[zobrist_table.black_to_move+2];
+    }
+    if(crs & BLACK_OO){
+        h ^= zobrist_table[zobrist_table.black_to_move+3];
+    }
+    if(crs & BLACK_OOO){
+        h ^= zobrist_table[zobrist_table.black_to_move+4];
+    }
+    if(is_en_passant(eps)){
+        h ^= zobrist_table[zobrist_table.black_to_move+5+(eps & 7)];
+    }
+    return h;
+}
+
+/// @brief Make a given move in the given board and update its zobrist key with only the squares the move touches
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param board bitboard array representing the board
+/// @param move move to make
+/// @param color player doing the move
+/// @param crs castling rights of the board
+/// @param eps en passant square
+/// @param zobrist_table reference to the Zobrist object
+/// @param key zobrist key of the board, updated to the key after the move
+template <typename Magic>
+void Board<Magic>::do_move(Bitboard board[], Move move, Color color, CastlingRights &crs, u8 &eps, Zobrist &zobrist_table, u64 &key){
+    key ^= zobrist_table[zobrist_table.black_to_move];
+    if(move.from == 255 && move.to == 255) return;
+    u64 state = zob_state(zobrist_table, crs, eps);
+
+    do_move(board, move, color, crs, eps);
+
+    key ^= state ^ zob_state(zobrist_table, crs, eps);
+    key ^= zobrist_table[move.piece*64+move.from];
+    if(in_range(move.get_en_passant(), 16, 47)){
+        key ^= zobrist_table[move.piece*64+move.to];
+        key ^= zobrist_table[move.capture_piece*64+(move.get_en_passant()+(color ? 8 : -8))];
+    }else if(move.capture_piece != 255 && (move.promotion_piece == 0 || move.promotion_piece == 255)){
+        key ^= zobrist_table[move.piece*64+move.to];
+        key ^= zobrist_table[move.capture_piece*64+move.to];
+    }else if(move.promotion_piece != 255){
+        key ^= zobrist_table[(move.promotion_piece+(color*6))*64+move.to];
+        if(move.capture_piece != 255){
+            key ^= zobrist_table[move.capture_piece*64+move.to];
+        }
+    }else{
+        key ^= zobrist_table[move.piece*64+move.to];
+        if(move.get_castling() == 1){
+            int rook = (color ? WHITE_ROOK-1 : BLACK_ROOK-1);
+            key ^= zobrist_table[rook*64+(color ? 63 : 7)] ^ zobrist_table[rook*64+(color ? 61 : 5)];
+        }else if(move.get_castling() == 2){
+            int rook = (color ? WHITE_ROOK-1 : BLACK_ROOK-1);
+            key ^= zobrist_table[rook*64+(color ? 56 : 0)] ^ zobrist_table[rook*64+(color ? 59 : 3)];
+        }
+    }
+}
+
 /// @brief Make a given move on the current board
 /// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param move move to make
 template <typename Magic>
 void Board<Magic>::do_move(Move move){
-    this->do_move(board, move, curr_player, castling_rights, en_passant);
+    this->do_move(board, move, curr_player, castling_rights, en_passant, *zobrist_table, key);
     if(move.capture_piece != 255 || move.piece == (curr_player*6)){
         rule50 = 0;
     }else{
@@ -416,12 +646,12 @@ void Board<Magic>::do_move(Move move){
     curr_turn++;
 }
 
-/// @brief Compute the zobrist hash of the current board
+/// @brief Get the zobrist hash of the current board, kept up to date by do_move
 /// @tparam Magic the type of magic the move generator is using, see config.h
 /// @return zobrist key
 template <typename Magic>
 u64 Board<Magic>::zob_hash(){
-    return zob_key(*zobrist_table, board, curr_player, castling_rights, en_passant, NULL, true);
+    return key;
 }
 
 template class Board<PEXT_Magic>;
@@ -23,6 +23,7 @@ class Board{
         unsigned int curr_turn;
         u8 en_passant;
         unsigned int rule50 = 0;
+        u64 key = 0;
 
         Board();
         Board(Zobrist *zobrist_table, MoveGenerator<Magic> *move_generator);
@@ -40,6 +41,13 @@ class Board{
         bool in_check(Bitboard board[], Bitboard empty_pieces, Color color);
 
         static void do_move(Bitboard board[], Move move, Color color, CastlingRights &crs, u8 &eps);
+        static void do_move(Bitboard board[], Move move, Color color, CastlingRights &crs, u8 &eps, Zobrist &zobrist_table, u64 &key);
+        static void undo_move(Bitboard board[], Move move, Color color);
+        static void move_occupancy(Bitboard occupancy[], Move move, Color color);
+        static void compute_occupancy(Bitboard board[], Bitboard occupancy[]);
+        static void move_mailbox(u8 mailbox[], Move move, Color color);
+        static void undo_mailbox(u8 mailbox[], Move move, Color color);
+        static void compute_mailbox(Bitboard board[], u8 mailbox[]);
         void do_move(Move move);
 
         u64 zob_hash();
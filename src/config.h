@@ -8,12 +8,23 @@
 
 #define MAX_HISTORY (1 << 24)
 
+#define MAX_PLY 256
+
+// Size of the perft hash table in MB, separate from the Hash option so perft does not double the memory in use
+#define PERFT_HASH_MB 64
+
+// Lazy SMP helpers publish their node count every this many nodes (power of two)
+#define NODES_PUBLISH_INTERVAL 1024
+
 #define SYZYGY_PIECES 5
 
 /// Use only one of the MAGIC's define instruction
 
+/// @brief --- Pick intel's pext or fixed magic when the engine starts, from the cpu features (see cpu.h).
+/// The engine is built for both and main runs the one that suits the cpu
+#define USE_RUNTIME_MAGIC
 /// @brief --- Use intel's pext instruction
-#define USE_INTEL_PEXT
+// #define USE_INTEL_PEXT
 /// @brief --- Use a software pext implementation
 // #define USE_PEXT
 /// @brief --- Use fixed magic to generate moves
@@ -23,14 +34,19 @@
 // #define MATERIAL_EVAL
 /// @brief --- Use neural network evaluation
 #define NN_EVAL
-/// @brief --- Use AVX instructions to make neural network evaluation
+/// @brief --- Use AVX instructions to make neural network evaluation, AVX2 or AVX-512 kernels are picked when the engine starts
 #define USE_AVX_NN
+/// @brief --- Use the quantized neural network (int16 weights and activations), see convert_nn
+// #define QUANTIZED_NN
 
-#if defined(USE_AVX_NN) || defined(USE_INTEL_PEXT)
+#if defined(USE_AVX_NN) || defined(USE_INTEL_PEXT) || defined(USE_RUNTIME_MAGIC)
     #include <immintrin.h>
 #endif
 
-#if defined(USE_PEXT) || defined(USE_INTEL_PEXT)
+#if defined(USE_RUNTIME_MAGIC)
+    #include "./magics/pext.h"
+    #include "./magics/fixed.h"
+#elif defined(USE_PEXT) || defined(USE_INTEL_PEXT)
     #include "./magics/pext.h"
     #define MAGIC PEXT_Magic
 #else
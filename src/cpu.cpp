@@ -0,0 +1,57 @@
+#include "cpu.h"
+#include <cpuid.h>
+#include <cstring>
+
+using namespace std;
+
+namespace arapaimachess{
+
+/// @brief Query the cpu, the OS support for the AVX registers is checked by __builtin_cpu_supports
+/// @return features of the cpu
+static CPUFeatures detect_cpu_features(){
+    CPUFeatures features;
+    __builtin_cpu_init();
+    features.avx2 = __builtin_cpu_supports("avx2");
+    features.avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    features.bmi2 = __builtin_cpu_supports("bmi2");
+
+    // AMD implements pext/pdep in microcode before Zen 3 (family 0x19), there they are slower than fixed magics
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    char vendor[13] = {0};
+    bool amd = false;
+    unsigned int family = 0;
+    if(__get_cpuid(0, &eax, &ebx, &ecx, &edx)){
+        memcpy(vendor, &ebx, 4);
+        memcpy(vendor + 4, &edx, 4);
+        memcpy(vendor + 8, &ecx, 4);
+        amd = strcmp(vendor, "AuthenticAMD") == 0;
+    }
+    if(__get_cpuid(1, &eax, &ebx, &ecx, &edx)){
+        family = (eax >> 8) & 0xf;
+        if(family == 0xf){
+            family += (eax >> 20) & 0xff;
+        }
+    }
+    features.fast_pext = features.bmi2 && !(amd && family < 0x19);
+    return features;
+}
+
+/// @brief Get the features of the cpu, they are only detected on the first call
+/// @return features of the cpu
+const CPUFeatures& cpu_features(){
+    static const CPUFeatures features = detect_cpu_features();
+    return features;
+}
+
+/// @brief Get the names of the instruction sets found on the cpu
+/// @return names separated by spaces, "none" if the cpu only has the baseline ones
+string cpu_features_string(){
+    const CPUFeatures &features = cpu_features();
+    string names = "";
+    if(features.avx2) names += " avx2";
+    if(features.avx512) names += " avx512";
+    if(features.bmi2) names += (features.fast_pext ? " bmi2" : " bmi2(slow pext)");
+    return names.empty() ? "none" : names.substr(1);
+}
+
+}
@@ -0,0 +1,23 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <string>
+
+using namespace std;
+
+namespace arapaimachess{
+
+/// @brief Instruction sets of the cpu running the engine, detected at startup so one build can pick its kernels
+struct CPUFeatures{
+    bool avx2 = false;
+    bool avx512 = false;    // AVX-512 F and BW
+    bool bmi2 = false;
+    bool fast_pext = false; // BMI2 without the microcoded pext/pdep of AMD cpus before Zen 3
+};
+
+const CPUFeatures& cpu_features();
+string cpu_features_string();
+
+}
+
+#endif
@@ -5,6 +5,9 @@
 #include <chrono>
 #include <cstring>
 #include "engine.h"
+#include "cpu.h"
+#include "./magics/pext.h"
+#include "./magics/fixed.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -18,35 +21,52 @@ using namespace std;
 
 namespace arapaimachess{
 
+// Depth skipping pattern of the Lazy SMP helpers, helper i skips depth d when ((d + skip_phase[i]) / skip_size[i]) is odd
+static const int skip_size[20]  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+static const int skip_phase[20] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+
 /// @brief Create a engine object
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param tt reference to the transposition table object
 /// @param zobrist_table reference to the Zobrist object
 /// @param move_generator reference to the MoveGenerator object
 /// @param search reference to the Search object
 /// @param board reference to the board object
-Engine::Engine(TT *tt, Zobrist *zobrist_table, MoveGenerator<MAGIC> *move_generator, Search *search, Board<MAGIC> *board){
+template <typename Magic>
+Engine<Magic>::Engine(TT *tt, Zobrist *zobrist_table, MoveGenerator<Magic> *move_generator, Search<Magic> *search, Board<Magic> *board){
     this->tt = tt;
     this->zobrist_table = zobrist_table;
     this->move_generator = move_generator;
     this->search = search;
     this->board = board;
 }
-Engine::~Engine(){}
+template <typename Magic>
+Engine<Magic>::~Engine(){
+    clear_helpers();
+    delete perft_tt;
+    perft_tt = NULL;
+}
 
-string Engine::get_name(){ return "id name ArapaimaChess " + version_number + "-" + version_type; }
-string Engine::get_info(){ return get_name() + "\nid author " + author + "\n"; }
+template <typename Magic>
+string Engine<Magic>::get_name(){ return "id name ArapaimaChess " + version_number + "-" + version_type; }
+template <typename Magic>
+string Engine<Magic>::get_info(){ return get_name() + "\nid author " + author + "\ninfo string cpu " + cpu_features_string() + "\n"; }
 
 /// @brief Get engine options for the uci command
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @return engine options
-string Engine::get_options(){
-    char buffer[5];
-    string options = "option name Hash type spin default 64 min ";
-    sprintf(buffer, "%d", hash_min);
-    options += string(buffer);
+template <typename Magic>
+string Engine<Magic>::get_options(){
+    string options = "option name Threads type spin default 1 min ";
+    options += to_string(threads_min);
+    options += " max ";
+    options += to_string(threads_max);
+    options += "\noption name Hash type spin default 64 min ";
+    options += to_string(hash_min);
     options += " max ";
-    sprintf(buffer, "%d", hash_max);
-    options += string(buffer);
+    options += to_string(hash_max);
     options += "\noption name Clear Hash type button\n";
+    options += "option name LargePages type check default false\n";
     options += "option name NullMove type check default false\n";
     options += "option name LateMove type check default false\n";
     options += "option name Futility type check default false\n";
@@ -56,45 +76,145 @@ string Engine::get_options(){
     options += "option name SyzygyPath type string default syzygy_table\n";
     return options;
 }
-string Engine::get_ready(){ return (ready ? "readyok\n" : "\0"); }
+template <typename Magic>
+string Engine<Magic>::get_ready(){ return (ready ? "readyok\n" : "\0"); }
 
-string Engine::print_board(){
+template <typename Magic>
+string Engine<Magic>::print_board(){
     return this->board->get_board();
 }
 
-void Engine::set_threads(int threads){
+/// @brief Set the number of search threads, the main thread plus threads-1 Lazy SMP helpers
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param threads number of threads
+template <typename Magic>
+void Engine<Magic>::set_threads(int threads){
     this->num_threads = threads;
+    this->move_generator->set_threads(threads);
+    this->tt->set_threads(threads);
+    clear_helpers();
+    for(int i = 1; i < threads; i++){
+        SearchThread<Magic> *helper = new SearchThread<Magic>();
+        helper->move_generator = new MoveGenerator<Magic>(*this->move_generator);
+        helper->move_generator->reset_history();
+        helper->search = new Search<Magic>(*this->search);
+        helper->search->set_move_generator(helper->move_generator);
+        helper->search->set_node_counter(&helper->nodes);
+        helpers.push_back(helper);
+    }
+}
+
+/// @brief Delete all Lazy SMP helpers
+/// @tparam Magic the type of magic the move generator is using, see config.h
+template <typename Magic>
+void Engine<Magic>::clear_helpers(){
+    for(SearchThread<Magic> *helper : helpers){
+        delete helper->search;
+        delete helper->move_generator;
+        delete helper;
+    }
+    helpers.clear();
+}
+
+/// @brief Resize the transposition table, it can come out smaller than asked when memory is short
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param size size in MB
+/// @return info string
+template <typename Magic>
+string Engine<Magic>::set_hash(u64 size){
+    if(!this->tt->resize(MB_to_TT(size))){
+        return "info string Could not allocate " + to_string(size) + " MB of hash\n" + this->get_hash_info();
+    }
+    this->tt_size = this->tt->get_MB();
+    return this->get_hash_info();
+}
+
+template <typename Magic>
+void Engine<Magic>::set_large_pages(bool set){
+    this->tt->set_large_pages(set);
 }
 
-void Engine::set_hash(int size){
-    this->tt->resize(MB_to_TT(size));
+/// @brief Get the info string describing the transposition table memory
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @return info string
+template <typename Magic>
+string Engine<Magic>::get_hash_info(){
+    return "info string Hash " + to_string(tt->get_MB()) + " MB allocated on " + tt->get_page_info() + "\n";
 }
 
-void Engine::set_null_move(bool set){
+/// @brief Save the transposition table to a file
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param path path of the file
+/// @return info string
+template <typename Magic>
+string Engine<Magic>::save_hash(string path){
+    if(!this->tt->save(path)){
+        return "info string Could not save hash to " + path + "\n";
+    }
+    return "info string Hash saved to " + path + "\n";
+}
+
+/// @brief Load the transposition table from a file saved with save_hash
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param path path of the file
+/// @return info string
+template <typename Magic>
+string Engine<Magic>::load_hash(string path){
+    if(!this->tt->load(path)){
+        return "info string Could not load hash from " + path + "\n";
+    }
+    this->tt_size = this->tt->get_MB();
+    return "info string Hash loaded from " + path + "\n" + this->get_hash_info();
+}
+
+template <typename Magic>
+void Engine<Magic>::set_null_move(bool set){
     this->search->set_null_move(set);
+    for(SearchThread<Magic> *helper : helpers){
+        helper->search->set_null_move(set);
+    }
 }
-void Engine::set_late_move(bool set){
+template <typename Magic>
+void Engine<Magic>::set_late_move(bool set){
     this->search->set_late_move(set);
+    for(SearchThread<Magic> *helper : helpers){
+        helper->search->set_late_move(set);
+    }
 }
-void Engine::set_futility(bool set){
+template <typename Magic>
+void Engine<Magic>::set_futility(bool set){
     this->search->set_futility(set);
+    for(SearchThread<Magic> *helper : helpers){
+        helper->search->set_futility(set);
+    }
 }
-void Engine::set_razoring(bool set){
+template <typename Magic>
+void Engine<Magic>::set_razoring(bool set){
     this->search->set_razoring(set);
+    for(SearchThread<Magic> *helper : helpers){
+        helper->search->set_razoring(set);
+    }
 }
 
-void Engine::set_position(string fen){
+template <typename Magic>
+void Engine<Magic>::set_position(string fen){
     this->board->initialize_board(fen);
 }
 
-void Engine::reset_search(){
+template <typename Magic>
+void Engine<Magic>::reset_search(){
     this->tt->clear();
 }
-void Engine::reset_history(){
+template <typename Magic>
+void Engine<Magic>::reset_history(){
     this->move_generator->reset_history();
+    for(SearchThread<Magic> *helper : helpers){
+        helper->move_generator->reset_history();
+    }
 }
 
-void Engine::stop(int type){
+template <typename Magic>
+void Engine<Magic>::stop(int type){
     if(type == 1){
         this->stop_search.store(true, memory_order_relaxed);
     }else if(type == 0){
@@ -104,9 +224,12 @@ void Engine::stop(int type){
 }
 
 /// @brief Make a given move in uci notation
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param move move in uci notation
-void Engine::make_move(string move){
-    vector<Move> moves = move_generator->legal_moves(board->board, board->curr_player, board->castling_rights, board->en_passant);
+template <typename Magic>
+void Engine<Magic>::make_move(string move){
+    MoveList moves;
+    move_generator->legal_moves(moves, board->board, board->curr_player, board->castling_rights, board->en_passant);
     for(Move m : moves){
         if(get_move_string(m) == move){
             last_move = move;
@@ -116,30 +239,69 @@ void Engine::make_move(string move){
     }
 }
 
+/// @brief Iterative deepening of a Lazy SMP helper, it only feeds the shared transposition table
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param helper helper thread state (search, history and pv)
+/// @param idx index of the helper, used to stagger the searched depths
+/// @param depth max depth to search for
+/// @param search_moves moves to search at start OR moves to search at each depth
+/// @param fixed_search search only search_moves at the first iteration
+/// @param hint toggle between moves to search at each depth (when true) or moves to search at the start (when false)
+template <typename Magic>
+void Engine<Magic>::helper_search(SearchThread<Magic> *helper, int idx, int depth, PVLine search_moves, bool fixed_search, bool hint){
+    Position<Magic> pos = Position<Magic>(zobrist_table, helper->move_generator);
+    pos.set(board->board, board->curr_player, board->castling_rights, board->en_passant, board->rule50, board->zob_hash());
+
+    int size = skip_size[idx % 20], phase = skip_phase[idx % 20];
+    u64 nodescount = 0;
+    helper->pv = PVLine();
+    helper->search->hits = 0;
+    helper->search->reset_killers();
+    for(int it_depth = 1; !stop_search.load(memory_order_relaxed) && it_depth <= depth; it_depth++){
+        if(((it_depth + phase) / size) % 2){
+            continue;
+        }
+        int score = helper->search->AlphaBeta(&stop_search, &helper->pv, nodescount, it_depth, it_depth, -2147400001, 2147400001, pos, *tt, &search_moves, !fixed_search, hint);
+        helper->nodes.store(nodescount, memory_order_relaxed);
+        helper->hits.store(helper->search->hits, memory_order_relaxed);
+        fixed_search = false;
+        if(abs(score) == 2147400000){
+            break;
+        }
+
+        search_moves.cmove = helper->pv.cmove;
+        memcpy(search_moves.argmove, helper->pv.argmove, helper->pv.cmove * sizeof(PackedMove));
+    }
+}
+
 /// @brief Start the search for a given position, sets the best move at the pv
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param depth max depth to search for
 /// @param moves moves to search at start OR moves to search at each depth
 /// @param hint toggle between moves to search at each depth (when true) or moves to search at the start (when false)
-void Engine::go_search(int depth, vector<string> moves, bool hint){
-    vector<Move> search_moves;
+template <typename Magic>
+void Engine<Magic>::go_search(int depth, vector<string> moves, bool hint){
+    PVLine search_moves;
     if(moves.size() > 0){
-        vector<Move> ms = move_generator->legal_moves(board->board, board->curr_player, board->castling_rights, board->en_passant);
+        MoveList ms;
+        move_generator->legal_moves(ms, board->board, board->curr_player, board->castling_rights, board->en_passant);
 
-        search_moves.reserve(moves.size());
         for(string move : moves){
             for(Move m : ms){
                 if(get_move_string(m) == move){
-                    search_moves.push_back(m);
+                    search_moves.argmove[search_moves.cmove++] = pack_move(m);
                     break;
                 }
             }
         }
     }
 
-    bool fixed_search = search_moves.size() > 0 && !hint;
-    stop_search.store(false, memory_order_relaxed);
+    bool fixed_search = search_moves.cmove > 0 && !hint;
+    // stop_search is cleared by the caller before this thread starts, clearing it here could drop a stop sent in between
     stoped_search.store(false, memory_order_relaxed);
     this->search->hits = 0;
+    this->search->reset_killers();
+    this->tt->new_search();
     nodes_count.store(0, memory_order_relaxed);
     d.store(0, memory_order_relaxed);
     pv_line = "";
@@ -147,28 +309,57 @@ void Engine::go_search(int depth, vector<string> moves, bool hint){
     bool syzygy_fail = false;
     while(eval == -2147400002 && !stop_search.load(memory_order_relaxed)){
         if(!syzygy || syzygy_fail || board->count_pieces() > TB_LARGEST){
+            vector<thread> helper_threads;
+            helper_threads.reserve(helpers.size());
+            for(size_t i = 0; i < helpers.size(); i++){
+                helpers[i]->nodes.store(0, memory_order_relaxed);
+                helpers[i]->hits.store(0, memory_order_relaxed);
+                helper_threads.emplace_back(&Engine<Magic>::helper_search, this, helpers[i], i+1, depth, search_moves, fixed_search, hint);
+            }
+
+            Position<Magic> pos = Position<Magic>(zobrist_table, move_generator);
+            pos.set(board->board, board->curr_player, board->castling_rights, board->en_passant, board->rule50, board->zob_hash());
+            u64 last_helper_nodes = 0;
             for(int it_depth = 1; !stop_search.load(memory_order_relaxed) && it_depth <= depth && abs(eval) != 2147400000; it_depth++){
                 u64 nodescount = 0;
-                eval.store(search->AlphaBeta(board->rule50, &stop_search, &pv, nodescount, it_depth, it_depth, -2147400001, 2147400001, board->board, board->curr_player, board->castling_rights, board->en_passant, *tt, search_moves, !fixed_search, hint) * (board->curr_player == BLACK ? -1 : 1), memory_order_relaxed);
-                nodes_count.store(nodescount, memory_order_relaxed);
+                eval.store(search->AlphaBeta(&stop_search, &pv, nodescount, it_depth, it_depth, -2147400001, 2147400001, pos, *tt, &search_moves, !fixed_search, hint) * (board->curr_player == BLACK ? -1 : 1), memory_order_relaxed);
+
+                // Nodes searched by the helpers since the last completed iteration are reported with it,
+                // the helpers publish their count while searching so unfinished helper iterations are included
+                u64 helper_nodes = 0;
+                int helper_hits = 0;
+                for(SearchThread<Magic> *helper : helpers){
+                    helper_nodes += helper->nodes.load(memory_order_relaxed);
+                    helper_hits += helper->hits.load(memory_order_relaxed);
+                }
+                nodes_count.store(nodescount + helper_nodes - last_helper_nodes, memory_order_relaxed);
+                last_helper_nodes = helper_nodes;
                 fixed_search = false;
                 
-                search_moves.clear();
-                search_moves.reserve(pv.cmove);
-                for(int i = 0; i < pv.cmove; i++){
-                    search_moves.push_back(pv.argmove[i]);
-                }
+                search_moves.cmove = pv.cmove;
+                memcpy(search_moves.argmove, pv.argmove, pv.cmove * sizeof(PackedMove));
                 
                 pv_line = "";
                 for(int i = 0; i < pv.cmove; i++){
-                    if(search_moves[i].from != 255){
-                        pv_line += get_move_string(search_moves[i]);
+                    if(!search_moves.argmove[i].empty()){
+                        pv_line += get_move_string(search_moves.argmove[i]);
                         pv_line += " ";
                     }
                 }
                 d.store(it_depth, memory_order_relaxed);
-                hits.store(search->hits, memory_order_relaxed);
+                hits.store(search->hits + helper_hits, memory_order_relaxed);
             }
+
+            stop_search.store(true, memory_order_relaxed);
+            for(thread &t : helper_threads){
+                t.join();
+            }
+            // Helper nodes searched after the last completed iteration
+            u64 helper_nodes = 0;
+            for(SearchThread<Magic> *helper : helpers){
+                helper_nodes += helper->nodes.load(memory_order_relaxed);
+            }
+            nodes_count.fetch_add(helper_nodes - last_helper_nodes, memory_order_relaxed);
         }else{
             pv.cmove = 1;
             Bitboard white_pieces = 0;
@@ -206,9 +397,9 @@ void Engine::go_search(int depth, vector<string> moves, bool hint){
                 Move m = create_move(
                     (f != t) ? f : 255,
                     t,
-                    255, 255, promo, 255, 255);
+                    255, 255, promo, 0, 0);
                 pv_line = get_move_string(m);
-                pv.argmove[0] = m;
+                pv.argmove[0] = pack_move(m);
                 pv.flags[0] = 2;
                 pv.eval[0] = eval_wdl[wdl];
                 pv.cmove = 0;
@@ -220,15 +411,26 @@ void Engine::go_search(int depth, vector<string> moves, bool hint){
     stoped_search.store(true, memory_order_relaxed);
 }
 
-/// @brief Run perft test for a given depth (go perft depth)
+/// @brief Run perft test for a given depth (go perft depth), the perft table is created on the first run with PERFT_HASH_MB
+/// and kept between runs, the search transposition table is not touched
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param depth depth to run the perft test for
 /// @return amount of positions found during the test
-u64 Engine::go_perft(int depth){
+template <typename Magic>
+u64 Engine<Magic>::go_perft(int depth){
     stoped_search.store(false, memory_order_relaxed);
-    u64 nodes = move_generator->perft_parallel(depth, board->board, board->curr_player, board->castling_rights, board->en_passant, *tt, false);
+    if(perft_tt == NULL){
+        perft_tt = new PerftTT(MB_to_TT(PERFT_HASH_MB));
+    }
+    Position<Magic> pos = Position<Magic>(zobrist_table, move_generator);
+    pos.set(board->board, board->curr_player, board->castling_rights, board->en_passant, board->rule50, board->zob_hash());
+    u64 nodes = move_generator->perft_parallel(depth, pos, *perft_tt);
     stop_search.store(true, memory_order_relaxed);
     stoped_search.store(true, memory_order_relaxed);
     return nodes;
 }
 
-}
\ No newline at end of file
+template class Engine<PEXT_Magic>;
+template class Engine<FIXED_Magic>;
+
+}
@@ -7,6 +7,8 @@
 #include "move_generator.h"
 #include "search.h"
 #include "transposition_table.h"
+#include "perft_table.h"
+#include "position.h"
 #include "entry.h"
 #include "config.h"
 #include "types.h"
@@ -18,29 +20,47 @@ using namespace std;
 
 namespace arapaimachess{
 
+/// @brief Helper thread of the Lazy SMP search, owns its search, history and pv, sharing only the transposition table.
+/// nodes is published by the helper search while it runs
+template <typename Magic>
+struct SearchThread{
+    MoveGenerator<Magic> *move_generator;
+    Search<Magic> *search;
+    PVLine pv;
+    atomic<u64> nodes = 0;
+    atomic<int> hits = 0;
+};
+
+template <typename Magic>
 class Engine{
     private:
         string version_number = "0.1";
         string version_type = "dev";
         string author = "devLIPEr";
 
-        int num_threads;
-        int tt_size;
+        int num_threads = 1;
+        u64 tt_size = 64;
 
         u64 seed;
 
         TT *tt;
+        PerftTT *perft_tt = NULL;
         Zobrist *zobrist_table;
-        Search *search;
+        Search<Magic> *search;
+        vector<SearchThread<Magic>*> helpers;
+
+        void clear_helpers();
+        void helper_search(SearchThread<Magic> *helper, int idx, int depth, PVLine search_moves, bool fixed_search, bool hint);
     public:
         bool ready = true;
         bool syzygy = false;
 
-        int hash_min = 1, hash_max = 1024;
-        Board<MAGIC> *board;
+        u64 hash_min = 1, hash_max = 33554432;
+        int threads_min = 1, threads_max = 256;
+        Board<Magic> *board;
         atomic<bool> stop_search;
-        atomic<bool> stoped_search;
-        MoveGenerator<MAGIC> *move_generator;
+        atomic<bool> stoped_search = true;
+        MoveGenerator<Magic> *move_generator;
         string last_move = "(none)";
 
         PVLine pv;
@@ -51,7 +71,7 @@ class Engine{
 
         atomic<int> hits;
 
-        Engine(TT *tt, Zobrist *zobrist_table, MoveGenerator<MAGIC> *move_generator, Search *search, Board<MAGIC> *board);
+        Engine(TT *tt, Zobrist *zobrist_table, MoveGenerator<Magic> *move_generator, Search<Magic> *search, Board<Magic> *board);
         ~Engine();
 
         string get_options();
@@ -62,7 +82,11 @@ class Engine{
         string print_board();
         
         void set_threads(int threads);
-        void set_hash(int size);
+        string set_hash(u64 size);
+        void set_large_pages(bool set);
+        string get_hash_info();
+        string save_hash(string path);
+        string load_hash(string path);
 
         void set_null_move(bool set);
         void set_late_move(bool set);
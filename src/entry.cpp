@@ -53,8 +53,8 @@ Entry::Entry(int depth, unsigned long long count, unsigned long long key, int ev
 /// @param key zobrist key for this position
 /// @param eval evaluation of this position
 /// @param flag prune type (UPPER, LOWER, EXACT) for this entry
-/// @param move move made to get here
-Entry::Entry(int depth, unsigned long long count, unsigned long long key, int eval, TT_FLAGS flag, Move move){
+/// @param move best move found in this position
+Entry::Entry(int depth, unsigned long long count, unsigned long long key, int eval, TT_FLAGS flag, PackedMove move){
     this->depth = depth;
     this->count = count;
     this->eval = eval;
@@ -12,14 +12,14 @@ class Entry{
     public:
         int depth = -1, eval = 0;
         unsigned long long count = 0;
-        Move move;
+        PackedMove move;
         unsigned long long key = 0;
-        TT_FLAGS flag;
+        TT_FLAGS flag = NO_FLAG;
 
         Entry(int depth, unsigned long long count, unsigned long long key);
         Entry(int depth, unsigned long long count, unsigned long long key, int eval);
         Entry(int depth, unsigned long long count, unsigned long long key, int eval, TT_FLAGS flag);
-        Entry(int depth, unsigned long long count, unsigned long long key, int eval, TT_FLAGS flag, Move move);
+        Entry(int depth, unsigned long long count, unsigned long long key, int eval, TT_FLAGS flag, PackedMove move);
         Entry() = default;
         Entry(const Entry& other) = default;
         ~Entry() = default;
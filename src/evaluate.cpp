@@ -1,9 +1,12 @@
 #include <iostream>
 #include <cstring>
+#include <cmath>
 #include <omp.h>
 
 #include "evaluate.h"
 #include "config.h"
+#include "utils.h"
+#include "cpu.h"
 
 using namespace std;
 
@@ -26,29 +29,181 @@ int material_evaluate(Bitboard board[], int material[], int n, int color_change_
     return eval;
 }
 
-/// @brief Read a binary file that contains the weights and biases of a nn
+#if defined(NN_EVAL)
+    /// @brief Read the first layer weights, the files keep them neuron-major and they are stored feature-major
+    /// @tparam T type of the weights
+    /// @param input file to read from
+    /// @param w1 where the weights are stored, one row of 16 weights for each input feature
+    template <typename T>
+    static void read_w1(ifstream &input, T w1[781][16]){
+        T *file_w1 = new T[16*781];
+        input.read(reinterpret_cast<char*>(file_w1), 781*16*sizeof(T));
+        for(int j = 0; j < 16; j++){
+            for(int k = 0; k < 781; k++){
+                w1[k][j] = file_w1[j*781 + k];
+            }
+        }
+        delete[] file_w1;
+    }
+
+    /// @brief Write the first layer weights neuron-major, the same layout read_w1 expects
+    /// @tparam T type of the weights
+    /// @param output file to write to
+    /// @param w1 weights stored feature-major
+    template <typename T>
+    static void write_w1(ofstream &output, const T w1[781][16]){
+        T *file_w1 = new T[16*781];
+        for(int j = 0; j < 16; j++){
+            for(int k = 0; k < 781; k++){
+                file_w1[j*781 + k] = w1[k][j];
+            }
+        }
+        output.write(reinterpret_cast<const char*>(file_w1), 781*16*sizeof(T));
+        delete[] file_w1;
+    }
+
+    /// @brief Read a binary file that contains the float weights and biases of a nn
+    /// @param path path to nn file
+    /// @param network where the weights and biases are stored
+    /// @return true if the whole network was read, false otherwise
+    static bool read_float_nn(string path, Network &network){
+        ifstream input(path, ios::binary);
+
+        read_w1(input, network.w1);
+        input.read(reinterpret_cast<char*>(network.b1), 1*16*sizeof(float));
+        input.read(reinterpret_cast<char*>(network.w2), 16*8*sizeof(float));
+        input.read(reinterpret_cast<char*>(network.b2), 1*8*sizeof(float));
+        input.read(reinterpret_cast<char*>(network.w3), 8*1*sizeof(float));
+        input.read(reinterpret_cast<char*>(network.b3), 1*1*sizeof(float));
+        return input.good();
+    }
+
+    #if defined(QUANTIZED_NN)
+        /// @brief Read a binary file written by convert_nn
+        /// @param path path to quantized nn file
+        /// @param qnetwork where the weights and biases are stored
+        /// @return true if the file is a quantized nn and it was fully read, false otherwise
+        static bool read_quantized_nn(string path, QuantizedNetwork &qnetwork){
+            ifstream input(path, ios::binary);
+
+            char magic[8];
+            input.read(magic, 8);
+            if(!input.good() || memcmp(magic, QNN_FILE_MAGIC, 8) != 0){
+                return false;
+            }
+            read_w1(input, qnetwork.w1);
+            input.read(reinterpret_cast<char*>(qnetwork.b1), 1*16*sizeof(i16));
+            input.read(reinterpret_cast<char*>(qnetwork.w2), 16*8*sizeof(i16));
+            input.read(reinterpret_cast<char*>(qnetwork.b2), 1*8*sizeof(i32));
+            input.read(reinterpret_cast<char*>(qnetwork.w3), 8*1*sizeof(i16));
+            input.read(reinterpret_cast<char*>(qnetwork.b3), 1*1*sizeof(i32));
+            return input.good();
+        }
+    #endif
+
+    /// @brief Round a value to its integer representation
+    /// @param value float value
+    /// @param scale integer value of 1.0
+    /// @param min smallest integer allowed
+    /// @param max biggest integer allowed
+    /// @return round(value*scale) clamped to [min, max]
+    static i32 quantize(float value, int scale, i32 min, i32 max){
+        long long q = llroundf(value*scale);
+        return (i32)(q < min ? min : (q > max ? max : q));
+    }
+
+    /// @brief Convert the float weights and biases to integers, see NN_QA, NN_QH, NN_QB and NN_QO for the scales
+    /// @param network float nn
+    /// @param qnetwork where the quantized nn is stored
+    void quantize_nn(const Network &network, QuantizedNetwork &qnetwork){
+        for(int k = 0; k < 781; k++){
+            for(int j = 0; j < 16; j++){
+                qnetwork.w1[k][j] = quantize(network.w1[k][j], NN_QA, -32767, 32767);
+            }
+        }
+        for(int j = 0; j < 16; j++){
+            qnetwork.b1[j] = quantize(network.b1[j], NN_QA, -32767, 32767);
+        }
+        for(int j = 0; j < 8; j++){
+            for(int k = 0; k < 16; k++){
+                qnetwork.w2[j][k] = quantize(network.w2[j][k], NN_QB, -32767, 32767);
+            }
+            qnetwork.b2[j] = quantize(network.b2[j], NN_QH*NN_QB, -2147483647, 2147483647);
+            qnetwork.w3[j] = quantize(network.w3[j], NN_QO, -32767, 32767);
+        }
+        qnetwork.b3[0] = quantize(network.b3[0], NN_QH*NN_QO, -2147483647, 2147483647);
+    }
+
+    /// @brief Convert a float nn file to a quantized nn file that read_nn can load when QUANTIZED_NN is defined
+    /// @param path path to the float nn file
+    /// @param quantized_path path to write the quantized nn file
+    /// @return true if the file was converted, false otherwise
+    bool convert_nn(string path, string quantized_path){
+        Network *network = new Network();
+        QuantizedNetwork *qnetwork = new QuantizedNetwork();
+
+        bool converted = read_float_nn(path, *network);
+        if(converted){
+            quantize_nn(*network, *qnetwork);
+
+            ofstream output(quantized_path, ios::binary);
+            output.write(QNN_FILE_MAGIC, 8);
+            write_w1(output, qnetwork->w1);
+            output.write(reinterpret_cast<char*>(qnetwork->b1), 1*16*sizeof(i16));
+            output.write(reinterpret_cast<char*>(qnetwork->w2), 16*8*sizeof(i16));
+            output.write(reinterpret_cast<char*>(qnetwork->b2), 1*8*sizeof(i32));
+            output.write(reinterpret_cast<char*>(qnetwork->w3), 8*1*sizeof(i16));
+            output.write(reinterpret_cast<char*>(qnetwork->b3), 1*1*sizeof(i32));
+            converted = output.good();
+        }
+
+        delete network;
+        delete qnetwork;
+        return converted;
+    }
+#endif
+
+/// @brief Read a binary file that contains the weights and biases of a nn, with QUANTIZED_NN defined
+/// a file written by convert_nn is loaded as is and a float file is quantized while loading
 /// @param path path to nn file
 void read_nn(string path){
-    ifstream input(path, ios::binary);
-
     #if defined(NN_EVAL)
-        input.read(reinterpret_cast<char*>(w1), 781*16*sizeof(float));
-        input.read(reinterpret_cast<char*>(b1), 1*16*sizeof(float));
-        input.read(reinterpret_cast<char*>(w2), 16*8*sizeof(float));
-        input.read(reinterpret_cast<char*>(b2), 1*8*sizeof(float));
-        input.read(reinterpret_cast<char*>(w3), 8*1*sizeof(float));
-        input.read(reinterpret_cast<char*>(b3), 1*1*sizeof(float));
+        #if defined(QUANTIZED_NN)
+            if(!read_quantized_nn(path, nn_network)){
+                Network *network = new Network();
+                read_float_nn(path, *network);
+                quantize_nn(*network, nn_network);
+                delete network;
+            }
+        #else
+            read_float_nn(path, nn_network);
+        #endif
     #endif
 }
 
-/// @brief Multiply matrix m1 and m2 then stores at r
+/// @brief Multiply matrix m1 and m2 then stores at r, portable kernel
 /// @param m1 matrix 1
 /// @param m2 matrix 2
 /// @param r result matrix
 /// @param m columns of first matrix and lines of second matrix
 /// @param q columns of second matrix
-void mul(float *m1, float *m2, float *r, int m, int q){
-    #if defined(USE_AVX_NN)
+static void mul_scalar(const float *m1, const float *m2, float *r, int m, int q){
+    for(int j = 0; j < q; j++){
+        for(int k = 0; k < m; k++){
+            r[j] += m1[k] * m2[j*m + k];
+        }
+    }
+}
+
+#if defined(USE_AVX_NN)
+    /// @brief Multiply matrix m1 and m2 then stores at r, AVX2 kernel
+    /// @param m1 matrix 1
+    /// @param m2 matrix 2
+    /// @param r result matrix
+    /// @param m columns of first matrix and lines of second matrix
+    /// @param q columns of second matrix
+    __attribute__((target("avx2")))
+    static void mul_avx2(const float *m1, const float *m2, float *r, int m, int q){
         const int VECTOR_SIZE = 8;
 
         for(int j = 0; j < q; j++){
@@ -79,20 +234,76 @@ void mul(float *m1, float *m2, float *r, int m, int q){
 
             r[j] = final_sum;
         }
-    #else
+    }
+
+    /// @brief Multiply matrix m1 and m2 then stores at r, AVX-512 kernel
+    /// @param m1 matrix 1
+    /// @param m2 matrix 2
+    /// @param r result matrix
+    /// @param m columns of first matrix and lines of second matrix
+    /// @param q columns of second matrix
+    __attribute__((target("avx512f,avx512bw")))
+    static void mul_avx512(const float *m1, const float *m2, float *r, int m, int q){
+        const int VECTOR_SIZE = 16;
+
         for(int j = 0; j < q; j++){
-            for(int k = 0; k < m; k++){
-                r[j] += m1[k] * m2[j*m + k];
+            const float *W_row = m2 + j*m;
+
+            __m512 acc_vec = _mm512_setzero_ps();
+
+            int k = 0;
+            for(; k + VECTOR_SIZE <= m; k += VECTOR_SIZE){
+                __m512 x_vec = _mm512_loadu_ps(m1 + k);
+                __m512 w_vec = _mm512_loadu_ps(W_row + k);
+                acc_vec = _mm512_add_ps(acc_vec, _mm512_mul_ps(x_vec, w_vec));
+            }
+            if(k < m){
+                // The last columns are loaded with a mask, the lanes past m are zero
+                __mmask16 mask = (__mmask16)((1U << (m - k)) - 1);
+                __m512 x_vec = _mm512_maskz_loadu_ps(mask, m1 + k);
+                __m512 w_vec = _mm512_maskz_loadu_ps(mask, W_row + k);
+                acc_vec = _mm512_add_ps(acc_vec, _mm512_mul_ps(x_vec, w_vec));
             }
+
+            alignas(64) float lanes[VECTOR_SIZE];
+            _mm512_store_ps(lanes, acc_vec);
+            float final_sum = 0;
+            for(int i = 0; i < VECTOR_SIZE; i++){
+                final_sum += lanes[i];
+            }
+
+            r[j] = final_sum;
         }
+    }
+#endif
+
+/// @brief Pick the fastest float kernel the cpu supports
+/// @return kernel used by mul
+static void (*select_mul_float())(const float *, const float *, float *, int, int){
+    #if defined(USE_AVX_NN)
+        if(cpu_features().avx512) return mul_avx512;
+        if(cpu_features().avx2) return mul_avx2;
     #endif
+    return mul_scalar;
+}
+
+static void (*const mul_float)(const float *, const float *, float *, int, int) = select_mul_float();
+
+/// @brief Multiply matrix m1 and m2 then stores at r, the kernel is picked for the cpu when the engine starts
+/// @param m1 matrix 1
+/// @param m2 matrix 2
+/// @param r result matrix, must be zeroed before the call
+/// @param m columns of first matrix and lines of second matrix
+/// @param q columns of second matrix
+void mul(const float *m1, const float *m2, float *r, int m, int q){
+    mul_float(m1, m2, r, m, q);
 }
 
 /// @brief Sum m2 into m1
 /// @param m1 matrix 1
 /// @param m2 matrix 2
 /// @param m number of columns
-void sum(float *m1, float *m2, int m){
+void sum(float *m1, const float *m2, int m){
     for(int j = 0; j < m; j++){
         m1[j] += m2[j];
     }
@@ -113,68 +324,325 @@ void act(float *m1, int m){
     }
 }
 
-/// @brief Evaluate a position using a simple MLP
-/// @param board array of bitboards
-/// @param cr castling rights
-/// @param ep en passant square
-/// @param player current player
-/// @return evaluation of the position [-20000, 20000]
-int nn_evaluate(Bitboard board[], CastlingRights cr, u8 ep, Color player){
-    #if defined(NN_EVAL)
-        memset(input, 0, sizeof(float)*781);
-        memset(r1, 0, sizeof(float)*16);
-        memset(r2, 0, sizeof(float)*8);
-        memset(r3, 0, sizeof(float)*1);
-        for(int i = 0; i < 12; i++){
-            uint64_t b = board[i];
-            int offset = i * 64;
-            while(b){
-                int idx = __builtin_ctzll(b);
-                input[offset + idx] = 1;
-                b &= b - 1; 
-            }
-        }
-        if(cr & WHITE_OO) input[768] = 1;
-        if(cr & WHITE_OOO) input[769] = 1;
-        if(cr & BLACK_OO) input[770] = 1;
-        if(cr & BLACK_OOO) input[771] = 1;
-        if(ep != 255) input[772 + ep] = 1;
-        if(player == BLACK) input[780] = 1;
-
-        // Layer 1
-        mul((float *)input, (float *)w1, (float *)r1, 781, 16);
-        sum((float *)r1, (float *)b1, 16);
-        act((float *)r1, 16);
-
-        // Layer 2
-        mul((float *)r1, (float *)w2, (float *)r2, 16, 8);
-        sum((float *)r2, (float *)b2, 8);
-        act((float *)r2, 8);
-
-        // Layer 3
-        mul((float *)r2, (float *)w3, (float *)r3, 8, 1);
-        sum((float *)r3, (float *)b3, 1);
-
-        return (int)(r3[0] * (40000.0f) - 20000.0f);
-    #else
-        return 0;
+#if defined(NN_EVAL)
+    /// @brief Multiply the int16 vector m1 and the int16 matrix m2 then stores at r, portable kernel
+    /// @param m1 vector of activations
+    /// @param m2 matrix of weights, one row of m values for each column of r
+    /// @param r result vector
+    /// @param m columns of first matrix and lines of second matrix
+    /// @param q columns of second matrix
+    static void mul_scalar(const i16 *m1, const i16 *m2, i32 *r, int m, int q){
+        for(int j = 0; j < q; j++){
+            const i16 *W_row = m2 + j*m;
+
+            i32 final_sum = 0;
+            for(int k = 0; k < m; k++){
+                final_sum += m1[k] * W_row[k];
+            }
+
+            r[j] = final_sum;
+        }
+    }
+
+    #if defined(USE_AVX_NN)
+        /// @brief Multiply the int16 vector m1 and the int16 matrix m2 then stores at r, AVX2 kernel
+        /// @param m1 vector of activations
+        /// @param m2 matrix of weights, one row of m values for each column of r
+        /// @param r result vector
+        /// @param m columns of first matrix and lines of second matrix
+        /// @param q columns of second matrix
+        __attribute__((target("avx2")))
+        static void mul_avx2(const i16 *m1, const i16 *m2, i32 *r, int m, int q){
+            const int VECTOR_SIZE = 16;
+
+            for(int j = 0; j < q; j++){
+                const i16 *W_row = m2 + j*m;
+
+                __m256i acc_vec = _mm256_setzero_si256();
+
+                int k = 0;
+                for(; k + VECTOR_SIZE <= m; k += VECTOR_SIZE){
+                    __m256i x_vec = _mm256_loadu_si256((const __m256i *)(m1 + k));
+                    __m256i w_vec = _mm256_loadu_si256((const __m256i *)(W_row + k));
+                    acc_vec = _mm256_add_epi32(acc_vec, _mm256_madd_epi16(x_vec, w_vec));
+                }
+
+                __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(acc_vec), _mm256_extracti128_si256(acc_vec, 1));
+                if(k + VECTOR_SIZE/2 <= m){
+                    __m128i x_vec = _mm_loadu_si128((const __m128i *)(m1 + k));
+                    __m128i w_vec = _mm_loadu_si128((const __m128i *)(W_row + k));
+                    sum128 = _mm_add_epi32(sum128, _mm_madd_epi16(x_vec, w_vec));
+                    k += VECTOR_SIZE/2;
+                }
+                sum128 = _mm_hadd_epi32(sum128, sum128);
+                sum128 = _mm_hadd_epi32(sum128, sum128);
+
+                i32 final_sum = _mm_cvtsi128_si32(sum128);
+
+                for(; k < m; k++){
+                    final_sum += m1[k] * W_row[k];
+                }
+
+                r[j] = final_sum;
+            }
+        }
+
+        /// @brief Multiply the int16 vector m1 and the int16 matrix m2 then stores at r, AVX-512 kernel
+        /// @param m1 vector of activations
+        /// @param m2 matrix of weights, one row of m values for each column of r
+        /// @param r result vector
+        /// @param m columns of first matrix and lines of second matrix
+        /// @param q columns of second matrix
+        __attribute__((target("avx512f,avx512bw")))
+        static void mul_avx512(const i16 *m1, const i16 *m2, i32 *r, int m, int q){
+            const int VECTOR_SIZE = 32;
+
+            for(int j = 0; j < q; j++){
+                const i16 *W_row = m2 + j*m;
+
+                __m512i acc_vec = _mm512_setzero_si512();
+
+                int k = 0;
+                for(; k + VECTOR_SIZE <= m; k += VECTOR_SIZE){
+                    __m512i x_vec = _mm512_loadu_si512((const void *)(m1 + k));
+                    __m512i w_vec = _mm512_loadu_si512((const void *)(W_row + k));
+                    acc_vec = _mm512_add_epi32(acc_vec, _mm512_madd_epi16(x_vec, w_vec));
+                }
+                if(k < m){
+                    // The last columns are loaded with a mask, the lanes past m are zero
+                    __mmask32 mask = (__mmask32)((1ULL << (m - k)) - 1);
+                    __m512i x_vec = _mm512_maskz_loadu_epi16(mask, m1 + k);
+                    __m512i w_vec = _mm512_maskz_loadu_epi16(mask, W_row + k);
+                    acc_vec = _mm512_add_epi32(acc_vec, _mm512_madd_epi16(x_vec, w_vec));
+                }
+
+                alignas(64) i32 lanes[VECTOR_SIZE/2];
+                _mm512_store_si512((void *)lanes, acc_vec);
+                i32 final_sum = 0;
+                for(int i = 0; i < VECTOR_SIZE/2; i++){
+                    final_sum += lanes[i];
+                }
+
+                r[j] = final_sum;
+            }
+        }
     #endif
-}
+
+    /// @brief Pick the fastest int16 kernel the cpu supports
+    /// @return kernel used by mul
+    static void (*select_mul_int())(const i16 *, const i16 *, i32 *, int, int){
+        #if defined(USE_AVX_NN)
+            if(cpu_features().avx512) return mul_avx512;
+            if(cpu_features().avx2) return mul_avx2;
+        #endif
+        return mul_scalar;
+    }
+
+    static void (*const mul_int)(const i16 *, const i16 *, i32 *, int, int) = select_mul_int();
+
+    /// @brief Multiply the int16 vector m1 and the int16 matrix m2 then stores at r, the kernel is picked for the cpu when the engine starts
+    /// @param m1 vector of activations
+    /// @param m2 matrix of weights, one row of m values for each column of r
+    /// @param r result vector
+    /// @param m columns of first matrix and lines of second matrix
+    /// @param q columns of second matrix
+    void mul(const i16 *m1, const i16 *m2, i32 *r, int m, int q){
+        mul_int(m1, m2, r, m, q);
+    }
+
+    /// @brief Sum m2 into m1
+    /// @param m1 matrix 1
+    /// @param m2 matrix 2
+    /// @param m number of columns
+    void sum(i32 *m1, const i32 *m2, int m){
+        for(int j = 0; j < m; j++){
+            m1[j] += m2[j];
+        }
+    }
+
+    /// @brief Apply SCReLU activation function on integers, x is clamped to [0, one] then x*x*NN_QH/(one*one) is stored
+    /// @tparam T integer type of the input
+    /// @param m1 matrix 1
+    /// @param r result matrix, [0, NN_QH]
+    /// @param m number of columns
+    /// @param one integer value of 1.0 in m1
+    template <typename T>
+    static void act(const T *m1, i16 *r, int m, i32 one){
+        for(int j = 0; j < m; j++){
+            long long x = m1[j];
+            if(x <= 0){
+                x = 0;
+            }else if(x >= one){
+                x = one;
+            }
+            r[j] = (i16)((x*x*NN_QH + (long long)one*one/2)/((long long)one*one));
+        }
+    }
+#endif
 
 #if defined(NN_EVAL)
-    float input[781];
-
-    float w1[16][781];
-    float b1[16];
-    float r1[16];
-
-    float w2[8][16];
-    float b2[8];
-    float r2[8];
-    
-    float w3[8];
-    float b3[1];
-    float r3[1];
+    EvalNetwork nn_network;
+
+    /// @brief Create an Evaluator object using the network read by read_nn
+    Evaluator::Evaluator(){
+        this->network = &nn_network;
+    }
+
+    /// @brief Create an Evaluator object
+    /// @param network weights and biases to evaluate with, shared between evaluators
+    Evaluator::Evaluator(const EvalNetwork *network){
+        this->network = network;
+    }
+
+    /// @brief Evaluate a position using a simple MLP
+    /// @param board array of bitboards
+    /// @param cr castling rights
+    /// @param ep en passant square
+    /// @param player current player
+    /// @return evaluation of the position [-20000, 20000]
+    int Evaluator::nn_evaluate(Bitboard board[], CastlingRights cr, u8 ep, Color player){
+        alignas(32) AccType accumulator[16];
+        nn_refresh(accumulator, board, cr, ep, player);
+        return nn_evaluate(accumulator);
+    }
+
+    /// @brief Evaluate a position from its first layer accumulator, only the two small layers are computed
+    /// @param accumulator first layer pre-activations of the position, see nn_refresh
+    /// @return evaluation of the position [-20000, 20000]
+    int Evaluator::nn_evaluate(AccType accumulator[]){
+        #if defined(QUANTIZED_NN)
+            // Layer 1
+            act(accumulator, this->r1, 16, NN_QA);
+
+            // Layer 2
+            mul(this->r1, (const i16 *)this->network->w2, this->r2, 16, 8);
+            sum(this->r2, this->network->b2, 8);
+            act(this->r2, this->a2, 8, NN_QH*NN_QB);
+
+            // Layer 3
+            mul(this->a2, this->network->w3, this->r3, 8, 1);
+            sum(this->r3, this->network->b3, 1);
+
+            return (int)((long long)this->r3[0] * 40000 / (NN_QH*NN_QO) - 20000);
+        #else
+            memcpy(this->r1, accumulator, sizeof(float)*16);
+            memset(this->r2, 0, sizeof(float)*8);
+            memset(this->r3, 0, sizeof(float)*1);
+
+            // Layer 1
+            act(this->r1, 16);
+
+            // Layer 2
+            mul(this->r1, (const float *)this->network->w2, this->r2, 16, 8);
+            sum(this->r2, this->network->b2, 8);
+            act(this->r2, 8);
+
+            // Layer 3
+            mul(this->r2, this->network->w3, this->r3, 8, 1);
+            sum(this->r3, this->network->b3, 1);
+
+            return (int)(this->r3[0] * (40000.0f) - 20000.0f);
+        #endif
+    }
+
+    /// @brief Turn on an input feature in the accumulator, the weights of a feature are one contiguous row
+    /// @param network weights of the nn
+    /// @param accumulator first layer pre-activations
+    /// @param feature index of the input feature [0, 780]
+    static inline void add_feature(const EvalNetwork *network, AccType accumulator[], int feature){
+        const AccType *row = network->w1[feature];
+        for(int j = 0; j < 16; j++){
+            accumulator[j] += row[j];
+        }
+    }
+
+    /// @brief Turn off an input feature in the accumulator
+    /// @param network weights of the nn
+    /// @param accumulator first layer pre-activations
+    /// @param feature index of the input feature [0, 780]
+    static inline void sub_feature(const EvalNetwork *network, AccType accumulator[], int feature){
+        const AccType *row = network->w1[feature];
+        for(int j = 0; j < 16; j++){
+            accumulator[j] -= row[j];
+        }
+    }
+
+    /// @brief Compute the first layer pre-activations (biases included) of a position from scratch
+    /// @param accumulator where the 16 pre-activations are stored
+    /// @param board array of bitboards
+    /// @param cr castling rights
+    /// @param ep en passant square
+    /// @param player current player
+    void Evaluator::nn_refresh(AccType accumulator[], Bitboard board[], CastlingRights cr, u8 ep, Color player){
+        // At most 32 pieces, 4 castling rights, 1 en passant file and the side to move are set out of the 781 inputs,
+        // only the rows of those features are added instead of multiplying the whole input
+        memcpy(accumulator, this->network->b1, sizeof(AccType)*16);
+        for(int i = 0; i < 12; i++){
+            Bitboard b = board[i];
+            while(b){
+                add_feature(this->network, accumulator, i*64 + __builtin_ctzll(b));
+                b &= b - 1;
+            }
+        }
+        for(int i = 0; i < 4; i++){
+            if(cr & (1 << i)) add_feature(this->network, accumulator, 768 + i);
+        }
+        if(ep != 255) add_feature(this->network, accumulator, 772 + (ep & 7));
+        if(player == BLACK) add_feature(this->network, accumulator, 780);
+    }
+
+    /// @brief Update the first layer pre-activations for a move, only the inputs the move changes are touched
+    /// @param accumulator pre-activations of the position before the move, updated in place
+    /// @param move move made, from and to equal to 255 for a null move
+    /// @param color player that did the move
+    /// @param old_cr castling rights before the move
+    /// @param new_cr castling rights after the move
+    /// @param old_ep en passant square before the move
+    /// @param new_ep en passant square after the move
+    void Evaluator::nn_update(AccType accumulator[], Move move, Color color, CastlingRights old_cr, CastlingRights new_cr, u8 old_ep, u8 new_ep){
+        const EvalNetwork *network = this->network;
+        if(move.from != 255 || move.to != 255){
+            sub_feature(network, accumulator, move.piece*64 + move.from);
+            if(in_range(move.get_en_passant(), 16, 47)){
+                sub_feature(network, accumulator, move.capture_piece*64 + move.get_en_passant()+(color ? 8 : -8));
+                add_feature(network, accumulator, move.piece*64 + move.to);
+            }else{
+                if(move.capture_piece != 255){
+                    sub_feature(network, accumulator, move.capture_piece*64 + move.to);
+                }
+                if(move.promotion_piece != 255 && (move.capture_piece == 255 || move.promotion_piece != 0)){
+                    add_feature(network, accumulator, (move.promotion_piece+color*6)*64 + move.to);
+                }else{
+                    add_feature(network, accumulator, move.piece*64 + move.to);
+                }
+                if(move.get_castling() == 1){
+                    u8 rook = (color ? WHITE_ROOK-1 : BLACK_ROOK-1);
+                    sub_feature(network, accumulator, rook*64 + (color ? 63 : 7));
+                    add_feature(network, accumulator, rook*64 + (color ? 61 : 5));
+                }else if(move.get_castling() == 2){
+                    u8 rook = (color ? WHITE_ROOK-1 : BLACK_ROOK-1);
+                    sub_feature(network, accumulator, rook*64 + (color ? 56 : 0));
+                    add_feature(network, accumulator, rook*64 + (color ? 59 : 3));
+                }
+            }
+        }
+
+        // Castling rights can only be lost
+        for(int i = 0; i < 4; i++){
+            if((old_cr & ~new_cr) & (1 << i)){
+                sub_feature(network, accumulator, 768 + i);
+            }
+        }
+        if(old_ep != new_ep){
+            if(old_ep != 255) sub_feature(network, accumulator, 772 + (old_ep & 7));
+            if(new_ep != 255) add_feature(network, accumulator, 772 + (new_ep & 7));
+        }
+        if(color == WHITE){
+            add_feature(network, accumulator, 780);
+        }else{
+            sub_feature(network, accumulator, 780);
+        }
+    }
 #else
     int evaluation[12] = {
         // Black Pieces
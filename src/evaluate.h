@@ -12,25 +12,82 @@ namespace arapaimachess{
 int material_evaluate(Bitboard board[], int material[], int n, int color_change_idx);
 
 void read_nn(string path);
-void mul(float *m1, float *m2, float *r, int m, int q);
-void sum(float *m1, float *m2, int m);
+void mul(const float *m1, const float *m2, float *r, int m, int q);
+void sum(float *m1, const float *m2, int m);
 void act(float *m1, int m);
-int nn_evaluate(Bitboard board[], CastlingRights cr, u8 ep, Color player);
 
 #if defined(NN_EVAL)
-    extern float input[781];
+    // Scales of the quantized nn, a float x is stored as round(x*scale)
+    #define NN_QA 4096  // first layer weights, biases and accumulator (int16)
+    #define NN_QH 4096  // hidden activations (int16)
+    #define NN_QB 8192  // second layer weights (int16)
+    #define NN_QO 16384 // output layer weights (int16)
+    #define QNN_FILE_MAGIC "ARAPQN01"
 
-    extern float w1[16][781];
-    extern float b1[16];
-    extern float r1[16];
+    /// @brief Weights and biases of the nn, read once by read_nn and only read afterwards so every thread can share it
+    struct Network{
+        alignas(32) float w1[781][16]; // feature-major, the files keep the neuron-major layout
+        alignas(32) float b1[16];
 
-    extern float w2[8][16];
-    extern float b2[8];
-    extern float r2[8];
+        alignas(32) float w2[8][16];
+        alignas(32) float b2[8];
 
-    extern float w3[8];
-    extern float b3[1];
-    extern float r3[1];
+        alignas(32) float w3[8];
+        alignas(32) float b3[1];
+    };
+
+    /// @brief Integer version of Network, see NN_QA, NN_QH, NN_QB and NN_QO for the scales
+    struct QuantizedNetwork{
+        alignas(32) i16 w1[781][16];
+        alignas(32) i16 b1[16];
+
+        alignas(32) i16 w2[8][16];
+        alignas(32) i32 b2[8];
+
+        alignas(32) i16 w3[8];
+        alignas(32) i32 b3[1];
+    };
+
+    #if defined(QUANTIZED_NN)
+        using AccType = i16;
+        using EvalNetwork = QuantizedNetwork;
+    #else
+        using AccType = float;
+        using EvalNetwork = Network;
+    #endif
+
+    extern EvalNetwork nn_network;
+
+    void quantize_nn(const Network &network, QuantizedNetwork &qnetwork);
+    bool convert_nn(string path, string quantized_path);
+    void mul(const i16 *m1, const i16 *m2, i32 *r, int m, int q);
+    void sum(i32 *m1, const i32 *m2, int m);
+
+    /// @brief Scratch buffers of the nn evaluation, each searching thread owns one so evaluations never share memory
+    class Evaluator{
+        private:
+            const EvalNetwork *network;
+
+            #if defined(QUANTIZED_NN)
+                alignas(32) i16 r1[16];
+                alignas(32) i32 r2[8];
+                alignas(32) i16 a2[8];
+                alignas(32) i32 r3[1];
+            #else
+                alignas(32) float r1[16];
+                alignas(32) float r2[8];
+                alignas(32) float r3[1];
+            #endif
+        public:
+            Evaluator();
+            Evaluator(const EvalNetwork *network);
+            ~Evaluator() = default;
+
+            int nn_evaluate(Bitboard board[], CastlingRights cr, u8 ep, Color player);
+            int nn_evaluate(AccType accumulator[]);
+            void nn_refresh(AccType accumulator[], Bitboard board[], CastlingRights cr, u8 ep, Color player);
+            void nn_update(AccType accumulator[], Move move, Color color, CastlingRights old_cr, CastlingRights new_cr, u8 old_ep, u8 new_ep);
+    };
 #else
     extern int evaluation[12];
 #endif
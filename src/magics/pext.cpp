@@ -2,7 +2,7 @@
 
 using namespace std;
 
-#ifndef USE_INTEL_PEXT
+#ifndef HARDWARE_PEXT
     u64 pext(u64 b, u64 mask){
         u64 result = 0;
         for(u64 bit = 1; mask; bit <<= 1){
@@ -4,12 +4,12 @@
 #include "../types.h"
 #include "../config.h"
 
-#ifdef USE_INTEL_PEXT
+// With USE_RUNTIME_MAGIC only pext.cpp is built with BMI2, PEXT_Magic is only created on cpus that have it
+#if defined(USE_INTEL_PEXT) || (defined(USE_RUNTIME_MAGIC) && defined(__BMI2__))
+    #define HARDWARE_PEXT
     #define pext _pext_u64
     #define pdep _pdep_u64
-#endif
-
-#if defined(USE_PEXT)
+#else
     u64 pext(u64 b, u64 mask);
     u64 pdep(u64 v, u64 mask);
 #endif
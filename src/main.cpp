@@ -10,24 +10,42 @@
 #include "transposition_table.h"
 #include "entry.h"
 #include "config.h"
+#include "cpu.h"
 
 using namespace std;
 using namespace arapaimachess;
 
-int main(){
-    u64 seed = 8428114415715405298ULL;
-
-    read_nn("./chess.nn");
+/// @brief Create the engine objects and read uci commands until quit
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param seed seed of the zobrist keys
+template <typename Magic>
+void run(u64 seed){
     TT tt = TT(MB_to_TT(64));
     Zobrist zobrist_table = Zobrist(seed);
-    MAGIC magic = MAGIC();
-    MoveGenerator<MAGIC> move_generator = MoveGenerator<MAGIC>(&zobrist_table, &magic, 3);
-    Search search = Search(&move_generator, &zobrist_table);
-    Board<MAGIC> board = Board<MAGIC>(&zobrist_table, &move_generator);
-    Engine engine = Engine(&tt, &zobrist_table, &move_generator, &search, &board);
-    UCI uci = UCI(&engine);
+    Magic magic = Magic();
+    MoveGenerator<Magic> move_generator = MoveGenerator<Magic>(&zobrist_table, &magic, 3);
+    Search<Magic> search = Search<Magic>(&move_generator, &zobrist_table);
+    Board<Magic> board = Board<Magic>(&zobrist_table, &move_generator);
+    Engine<Magic> engine = Engine<Magic>(&tt, &zobrist_table, &move_generator, &search, &board);
+    UCI<Magic> uci = UCI<Magic>(&engine);
 
     uci.read();
+}
+
+int main(){
+    u64 seed = 8428114415715405298ULL;
+
+    read_nn("./chess.nn");
+    #if defined(USE_RUNTIME_MAGIC)
+        // The magic is picked once here, the move generation calls it directly
+        if(cpu_features().fast_pext){
+            run<PEXT_Magic>(seed);
+        }else{
+            run<FIXED_Magic>(seed);
+        }
+    #else
+        run<MAGIC>(seed);
+    #endif
 
     return 0;
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 #include "utils.h"
 #include "evaluate.h"
 #include "board.h"
+#include "position.h"
 #include "./magics/pext.h"
 #include "./magics/fixed.h"
 
@@ -23,18 +24,27 @@ MoveGenerator<Magic>::MoveGenerator(Zobrist *zobrist_table, Magic *magic, int th
     this->zobrist_table = zobrist_table;
     this->magic = magic;
     this->num_threads = threads;
-    memset(this->history, 0, 2*64*64*sizeof(u8));
+    memset(this->history, 0, 2*64*64*sizeof(int));
 }
 template <typename Magic>
 MoveGenerator<Magic>::MoveGenerator(){
-    memset(this->history, 0, 2*64*64*sizeof(u8));
+    memset(this->history, 0, 2*64*64*sizeof(int));
+}
+
+/// @brief Set the number of threads used by the parallel perft
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param threads number of threads
+template <typename Magic>
+void MoveGenerator<Magic>::set_threads(int threads){
+    assert(threads > 0);
+    this->num_threads = threads;
 }
 
 /// @brief Reset move history heuristic values
 /// @tparam Magic the type of magic the move generator is using, see config.h
 template <typename Magic>
 void MoveGenerator<Magic>::reset_history(){
-    memset(this->history, 0, 2*64*64*sizeof(u8));
+    memset(this->history, 0, 2*64*64*sizeof(int));
 }
 
 /// @brief Add move to the history heuristic
@@ -50,6 +60,16 @@ void MoveGenerator<Magic>::add_history(Color player, Move move, int depth){
     }
 }
 
+/// @brief Get the history heuristic value of a move
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param player player playing the move
+/// @param move move to look up
+/// @return history value
+template <typename Magic>
+int MoveGenerator<Magic>::get_history(Color player, Move move){
+    return this->history[player][move.from][move.to];
+}
+
 template <typename Magic>
 Bitboard MoveGenerator<Magic>::get_attack_rook(int sq, Bitboard occ){
     return this->magic->get_attack_rook(sq, occ);
@@ -115,7 +135,7 @@ bool MoveGenerator<Magic>::is_square_attacked(u8 square, Bitboard board[], Bitbo
 /// @brief Extract capture moves of a given bitboard
 /// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param orig move list to append the move to
-/// @param boards bitboard array of all pieces
+/// @param mailbox piece index on each square, 255 for empty squares
 /// @param board bitboard of the captures
 /// @param offset offset of the pawn move, used to calculate where the pawn came from
 /// @param opp_pawn index of opponent pawn bitboard in the array
@@ -123,25 +143,15 @@ bool MoveGenerator<Magic>::is_square_attacked(u8 square, Bitboard board[], Bitbo
 /// @param promotion_piece piece to promote for
 /// @param passant en passant square
 template <typename Magic>
-void MoveGenerator<Magic>::extract_pawn_captures(vector<Move> &orig, Bitboard boards[], Bitboard board, int offset, u8 opp_pawn, u8 piece, u8 promotion_piece, u8 passant){
-    u8 capture_piece = opp_pawn+5, opp_king = opp_pawn+5;
+void MoveGenerator<Magic>::extract_pawn_captures(MoveList &orig, u8 mailbox[], Bitboard board, int offset, u8 opp_pawn, u8 piece, u8 promotion_piece, u8 passant){
+    u8 capture_piece, opp_king = opp_pawn+5;
     int index;
     while(board){
         capture_piece = opp_pawn;
         index = __builtin_ctzll(board);
         board &= board-1;
         if(passant == 0){
-            if((1ULL << index) & boards[opp_pawn]){
-                capture_piece = opp_pawn;
-            }else if((1ULL << index) & boards[opp_pawn+1]){
-                capture_piece = opp_pawn+1;
-            }else if((1ULL << index) & boards[opp_pawn+2]){
-                capture_piece = opp_pawn+2;
-            }else if((1ULL << index) & boards[opp_pawn+3]){
-                capture_piece = opp_pawn+3;
-            }else if((1ULL << index) & boards[opp_pawn+4]){
-                capture_piece = opp_pawn+4;
-            }
+            capture_piece = mailbox[index];
             capture_piece = (capture_piece != opp_king ? capture_piece : 255);
         }
         orig.push_back(create_move(index+offset, index, piece, capture_piece, promotion_piece, passant, 0));
@@ -156,7 +166,7 @@ void MoveGenerator<Magic>::extract_pawn_captures(vector<Move> &orig, Bitboard bo
 /// @param piece index of player's pawn in the bitboard array
 /// @param promotion_piece piece to promote for
 template <typename Magic>
-void MoveGenerator<Magic>::extract_pawn_moves(vector<Move> &orig, Bitboard board, int offset, u8 piece, u8 promotion_piece){
+void MoveGenerator<Magic>::extract_pawn_moves(MoveList &orig, Bitboard board, int offset, u8 piece, u8 promotion_piece){
     int index;
     while(board){
         index = __builtin_ctzll(board);
@@ -168,7 +178,9 @@ void MoveGenerator<Magic>::extract_pawn_moves(vector<Move> &orig, Bitboard board
 /// @brief Generate all pawn moves for a given player in a given board
 /// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param moves move list to append the moves to
+/// @param gen_type kind of moves to generate
 /// @param board bitboard array of all pieces
+/// @param mailbox piece index on each square, 255 for empty squares
 /// @param color player's color
 /// @param index index of player's pawn in the bitboard array
 /// @param opp_pawn index of opponent pawn bitboard in the array
@@ -176,7 +188,7 @@ void MoveGenerator<Magic>::extract_pawn_moves(vector<Move> &orig, Bitboard board
 /// @param empty_pieces bitboard of empty squares
 /// @param en_passant_bb bitboard of en passant square
 template <typename Magic>
-void MoveGenerator<Magic>::generate_pawn_moves(vector<Move> &moves, Bitboard board[], Color color, int index, int opp_pawn, Bitboard opp_pieces, Bitboard empty_pieces, Bitboard en_passant_bb){
+void MoveGenerator<Magic>::generate_pawn_moves(MoveList &moves, GenType gen_type, Bitboard board[], u8 mailbox[], Color color, int index, int opp_pawn, Bitboard opp_pieces, Bitboard empty_pieces, Bitboard en_passant_bb){
     Bitboard single_push = shift(board[index], (color ? -8 : 8)) & empty_pieces;
     Bitboard promotion = single_push & (color == WHITE ? RANK_8 : RANK_1);
     single_push = single_push & ~(color == WHITE ? RANK_8 : RANK_1);
@@ -190,38 +202,33 @@ void MoveGenerator<Magic>::generate_pawn_moves(vector<Move> &moves, Bitboard boa
     Bitboard right_attack = shift((board[index] & ~0x8080808080808080), (color ? -7 : 9));
     Bitboard right_capture = right_attack & opp_pieces;
     Bitboard right_en_passant = right_attack & en_passant_bb;
-    moves.reserve(
-        moves.size()+
-        __builtin_popcount(single_push)+
-        __builtin_popcount(promotion)*4+
-        __builtin_popcount(double_push)+
-        __builtin_popcount(left_capture)+
-        __builtin_popcount(left_en_passant)+
-        __builtin_popcount(left_capture & (color == WHITE ? RANK_8 : RANK_1))*4+
-        __builtin_popcount(right_capture)+
-        __builtin_popcount(right_en_passant)+
-        __builtin_popcount(right_capture & (color == WHITE ? RANK_8 : RANK_1))*4
-    );
-    extract_pawn_moves(moves, single_push, (color ? 8 : -8), index, 0);
+    if(gen_type != GEN_CAPTURES){
+        extract_pawn_moves(moves, single_push, (color ? 8 : -8), index, 0);
+    }
     
-    if(promotion){
+    if(promotion && gen_type != GEN_QUIETS){
         for(int type = KNIGHT; type < KING; type++){
             extract_pawn_moves(moves, promotion, (color ? 8 : -8), index, type-1);
         }
     }
-    extract_pawn_moves(moves, double_push, (color ? 16 : -16), index, 0);
-    extract_pawn_captures(moves, board, left_capture & ~(color == WHITE ? RANK_8 : RANK_1), (color ? 9 : -7), opp_pawn, index, 0, 0);
-    extract_pawn_captures(moves, board, left_en_passant, (color ? 9 : -7), opp_pawn, index, 0, __builtin_ctzll(left_en_passant));
+    if(gen_type != GEN_CAPTURES){
+        extract_pawn_moves(moves, double_push, (color ? 16 : -16), index, 0);
+    }
+    if(gen_type == GEN_QUIETS){
+        return;
+    }
+    extract_pawn_captures(moves, mailbox, left_capture & ~(color == WHITE ? RANK_8 : RANK_1), (color ? 9 : -7), opp_pawn, index, 0, 0);
+    extract_pawn_captures(moves, mailbox, left_en_passant, (color ? 9 : -7), opp_pawn, index, 0, __builtin_ctzll(left_en_passant));
     if(left_capture & (color == WHITE ? RANK_8 : RANK_1)){
         for(int type = KNIGHT; type < KING; type++){
-            extract_pawn_captures(moves, board, left_capture & (color == WHITE ? RANK_8 : RANK_1), (color ? 9 : -7), opp_pawn, index, type-1, 0);
+            extract_pawn_captures(moves, mailbox, left_capture & (color == WHITE ? RANK_8 : RANK_1), (color ? 9 : -7), opp_pawn, index, type-1, 0);
         }
     }
-    extract_pawn_captures(moves, board, right_capture & ~(color == WHITE ? RANK_8 : RANK_1), (color ? 7 : -9), opp_pawn, index, 0, 0);
-    extract_pawn_captures(moves, board, right_en_passant, (color ? 7 : -9), opp_pawn, index, 0, __builtin_ctzll(right_en_passant));
+    extract_pawn_captures(moves, mailbox, right_capture & ~(color == WHITE ? RANK_8 : RANK_1), (color ? 7 : -9), opp_pawn, index, 0, 0);
+    extract_pawn_captures(moves, mailbox, right_en_passant, (color ? 7 : -9), opp_pawn, index, 0, __builtin_ctzll(right_en_passant));
     if(right_capture & (color == WHITE ? RANK_8 : RANK_1)){
         for(int type = KNIGHT; type < KING; type++){
-            extract_pawn_captures(moves, board, right_capture & (color == WHITE ? RANK_8 : RANK_1), (color ? 7 : -9), opp_pawn, index, type-1, 0);
+            extract_pawn_captures(moves, mailbox, right_capture & (color == WHITE ? RANK_8 : RANK_1), (color ? 7 : -9), opp_pawn, index, type-1, 0);
         }
     }
 }
@@ -229,30 +236,18 @@ void MoveGenerator<Magic>::generate_pawn_moves(vector<Move> &moves, Bitboard boa
 /// @brief Extract capture moves from a given bitboard
 /// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param orig move list to append the move to
-/// @param boards bitboard array of all pieces
+/// @param mailbox piece index on each square, 255 for empty squares
 /// @param board bitboard of the captures
 /// @param from square the piece came from
 /// @param opp_pawn index of opponent pawn bitboard in the array
 /// @param piece index of player's pawn in the bitboard array
 template <typename Magic>
-void MoveGenerator<Magic>::extract_capture_moves(vector<Move> &orig, Bitboard boards[], Bitboard board, u8 from, u8 opp_pawn, u8 piece){
-    u8 capture_piece = opp_pawn+5, opp_king = opp_pawn+5;
+void MoveGenerator<Magic>::extract_capture_moves(MoveList &orig, u8 mailbox[], Bitboard board, u8 from, u8 opp_pawn, u8 piece){
+    u8 capture_piece, opp_king = opp_pawn+5;
     int index;
     while(board){
-        capture_piece = opp_pawn;
         index = __builtin_ctzll(board);
-
-        if((1ULL << index) & boards[opp_pawn]){
-            capture_piece = opp_pawn;
-        }else if((1ULL << index) & boards[opp_pawn+1]){
-            capture_piece = opp_pawn+1;
-        }else if((1ULL << index) & boards[opp_pawn+2]){
-            capture_piece = opp_pawn+2;
-        }else if((1ULL << index) & boards[opp_pawn+3]){
-            capture_piece = opp_pawn+3;
-        }else if((1ULL << index) & boards[opp_pawn+4]){
-            capture_piece = opp_pawn+4;
-        }
+        capture_piece = mailbox[index];
 
         board &= board-1;
         orig.push_back(create_move(from, index, piece, (capture_piece != opp_king ? capture_piece : 255), 255, 0, 0));
@@ -266,7 +261,7 @@ void MoveGenerator<Magic>::extract_capture_moves(vector<Move> &orig, Bitboard bo
 /// @param from square the piece came from
 /// @param piece index of player's pawn in the bitboard array
 template <typename Magic>
-void MoveGenerator<Magic>::extract_moves(vector<Move> &orig, Bitboard board, u8 from, u8 piece){
+void MoveGenerator<Magic>::extract_moves(MoveList &orig, Bitboard board, u8 from, u8 piece){
     int index;
     while(board){
         index = __builtin_ctzll(board);
@@ -278,24 +273,26 @@ void MoveGenerator<Magic>::extract_moves(vector<Move> &orig, Bitboard board, u8
 /// @brief Generate all knights moves for a given position
 /// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param moves move list to append the moves to
+/// @param gen_type kind of moves to generate
 /// @param board bitboard array of all pieces
+/// @param mailbox piece index on each square, 255 for empty squares
 /// @param piece_index index of player's knight in the bitboard array
 /// @param opp_pawn index of opponent pawn bitboard in the array
 /// @param opp_pieces bitboard of the opponent pieces
 /// @param empty_pieces bitboard of empty squares
 template <typename Magic>
-void MoveGenerator<Magic>::generate_knight_moves(vector<Move> &moves, Bitboard board[], int piece_index, int opp_pawn, Bitboard opp_pieces, Bitboard empty_pieces){
+void MoveGenerator<Magic>::generate_knight_moves(MoveList &moves, GenType gen_type, Bitboard board[], u8 mailbox[], int piece_index, int opp_pawn, Bitboard opp_pieces, Bitboard empty_pieces){
     Bitboard knight = board[piece_index], knights_attacks, knight_move, knight_captures;
+    Bitboard quiet_mask = (gen_type != GEN_CAPTURES) ? empty_pieces : 0, capture_mask = (gen_type != GEN_QUIETS) ? opp_pieces : 0;
     int index;
     while(knight){
         index = __builtin_ctzll(knight);
         knights_attacks = get_attack_knight(index);
 
-        knight_move = knights_attacks & empty_pieces;
-        knight_captures = knights_attacks & opp_pieces;
-        moves.reserve(moves.size() + __builtin_popcount(knight_move) + __builtin_popcount(knight_captures));
+        knight_move = knights_attacks & quiet_mask;
+        knight_captures = knights_attacks & capture_mask;
         extract_moves(moves, knight_move, index, piece_index);
-        extract_capture_moves(moves, board, knight_captures, index, opp_pawn, piece_index);
+        extract_capture_moves(moves, mailbox, knight_captures, index, opp_pawn, piece_index);
         knight &= knight-1;
     }
 }
@@ -311,10 +308,52 @@ bool MoveGenerator<Magic>::in_check(Bitboard board[], Bitboard empty_pieces, Col
     return is_square_attacked(__builtin_ctzll(board[(color ? WHITE_KING-1 : BLACK_KING-1)]), board, empty_pieces, color);
 }
 
+/// @brief Get the opponent pieces attacking a square
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param square square index
+/// @param board bitboard array of all pieces
+/// @param all_pieces bitboard of all pieces, sliders are blocked by it
+/// @param color player's color, the attackers are the pieces of the other player
+/// @return bitboard of the attackers
+template <typename Magic>
+Bitboard MoveGenerator<Magic>::attackers_to(u8 square, Bitboard board[], Bitboard all_pieces, Color color){
+    int opp_pawn = (color) ? 0 : 6;
+    Bitboard square_bb = (1ULL << square);
+    Bitboard pawn_attack = shift((square_bb & ~0x0101010101010101), (color ? -9 : 7)) | shift((square_bb & ~0x8080808080808080), (color ? -7 : 9));
+    return (
+        (get_attack_bishop(square, all_pieces) & (board[opp_pawn+BISHOP-1] | board[opp_pawn+QUEEN-1])) |
+        (get_attack_rook(square, all_pieces) & (board[opp_pawn+ROOK-1] | board[opp_pawn+QUEEN-1])) |
+        (get_attack_knight(square) & board[opp_pawn+KNIGHT-1]) |
+        (get_attack_king(square) & board[opp_pawn+KING-1]) |
+        (pawn_attack & board[opp_pawn+PAWN-1])
+    );
+}
+
+/// @brief Get the squares strictly between two squares on the same rank, file or diagonal
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param from first square
+/// @param to second square
+/// @return bitboard of the squares between, 0 if the squares are not aligned
+template <typename Magic>
+Bitboard MoveGenerator<Magic>::between(u8 from, u8 to){
+    Bitboard from_bb = (1ULL << from), to_bb = (1ULL << to);
+    Bitboard rook = get_attack_rook(from, to_bb);
+    if(rook & to_bb){
+        return rook & get_attack_rook(to, from_bb);
+    }
+    Bitboard bishop = get_attack_bishop(from, to_bb);
+    if(bishop & to_bb){
+        return bishop & get_attack_bishop(to, from_bb);
+    }
+    return 0;
+}
+
 /// @brief Generate all king moves for the given player
 /// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param moves move list to append the moves to
+/// @param gen_type kind of moves to generate
 /// @param board bitboard array of all pieces
+/// @param mailbox piece index on each square, 255 for empty squares
 /// @param color player to generate moves
 /// @param piece_index index of player's king in the bitboard array
 /// @param opp_pawn index of opponent pawn bitboard in the array
@@ -323,15 +362,17 @@ bool MoveGenerator<Magic>::in_check(Bitboard board[], Bitboard empty_pieces, Col
 /// @param empty_pieces bitboard of empty squares
 /// @param crs castling rights
 template <typename Magic>
-void MoveGenerator<Magic>::generate_king_moves(vector<Move> &moves, Bitboard board[], Color color, int piece_index, int opp_pawn, Bitboard all_pieces, Bitboard opp_pieces, Bitboard empty_pieces, CastlingRights crs){
+void MoveGenerator<Magic>::generate_king_moves(MoveList &moves, GenType gen_type, Bitboard board[], u8 mailbox[], Color color, int piece_index, int opp_pawn, Bitboard all_pieces, Bitboard opp_pieces, Bitboard empty_pieces, CastlingRights crs){
     int king_s = __builtin_ctzll(board[piece_index]);
     Bitboard king_moves = get_attack_king(king_s), king_square = board[piece_index];
 
-    Bitboard king_captures = king_moves & opp_pieces;
-    king_moves = king_moves & empty_pieces;
-    moves.reserve(moves.size() + __builtin_popcount(king_moves) + __builtin_popcount(king_captures));
+    Bitboard king_captures = king_moves & ((gen_type != GEN_QUIETS) ? opp_pieces : 0);
+    king_moves = king_moves & ((gen_type != GEN_CAPTURES) ? empty_pieces : 0);
     extract_moves(moves, king_moves, king_s, piece_index);
-    extract_capture_moves(moves, board, king_captures, king_s, opp_pawn, piece_index);
+    extract_capture_moves(moves, mailbox, king_captures, king_s, opp_pawn, piece_index);
+    if(gen_type == GEN_CAPTURES){
+        return;
+    }
 
     CastlingRights oo = (color ? WHITE_OO : BLACK_OO), ooo = (color ? WHITE_OOO : BLACK_OOO);
     i8 castling_shift_oo = 1;
@@ -348,15 +389,18 @@ void MoveGenerator<Magic>::generate_king_moves(vector<Move> &moves, Bitboard boa
 /// @brief Generate all sliding moves
 /// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param moves move list to append the moves to
+/// @param gen_type kind of moves to generate
 /// @param board bitboard array of all pieces
+/// @param mailbox piece index on each square, 255 for empty squares
 /// @param color player to generate moves
 /// @param piece_index index of player's slider in the bitboard array
 /// @param opp_pawn index of opponent pawn bitboard in the array
 /// @param opp_pieces bitboard of the opponent pieces
 /// @param empty_pieces bitboard of empty squares
 template <typename Magic>
-void MoveGenerator<Magic>::generate_sliding_moves(vector<Move> &moves, Bitboard board[], Color color, int piece_index, int opp_pawn, Bitboard opp_pieces, Bitboard empty_pieces){
+void MoveGenerator<Magic>::generate_sliding_moves(MoveList &moves, GenType gen_type, Bitboard board[], u8 mailbox[], Color color, int piece_index, int opp_pawn, Bitboard opp_pieces, Bitboard empty_pieces){
     Bitboard sliding_piece = board[piece_index], pattern;
+    Bitboard quiet_mask = (gen_type != GEN_CAPTURES) ? empty_pieces : 0, capture_mask = (gen_type != GEN_QUIETS) ? opp_pieces : 0;
     int index, side = (color*6)-1;
     while(sliding_piece){
         index = __builtin_ctzll(sliding_piece);
@@ -367,23 +411,41 @@ void MoveGenerator<Magic>::generate_sliding_moves(vector<Move> &moves, Bitboard
         }else{
             pattern = get_attack_rook(index, ~empty_pieces) | get_attack_bishop(index, ~empty_pieces);
         }
-        moves.reserve(moves.size() + __builtin_popcount(pattern & empty_pieces) + __builtin_popcount(pattern & opp_pieces));
-        extract_moves(moves, pattern & empty_pieces, index, piece_index);
-        extract_capture_moves(moves, board, pattern & opp_pieces, index, opp_pawn, piece_index);
+        extract_moves(moves, pattern & quiet_mask, index, piece_index);
+        extract_capture_moves(moves, mailbox, pattern & capture_mask, index, opp_pawn, piece_index);
         sliding_piece &= sliding_piece-1;
     }
 }
 
 /// @brief Generate pseudolegal moves
 /// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param moves move list to fill
 /// @param board bitboard array of all pieces
 /// @param color player to generate moves
 /// @param crs castling rights
 /// @param eps en passant square
-/// @return list of pseudolegal moves
 template <typename Magic>
-vector<Move> MoveGenerator<Magic>::pseudolegal_moves(Bitboard board[], Color color, CastlingRights crs, u8 eps){
-    vector<Move> moves;
+void MoveGenerator<Magic>::pseudolegal_moves(MoveList &moves, Bitboard board[], Color color, CastlingRights crs, u8 eps){
+    Bitboard occupancy[3];
+    u8 mailbox[64];
+    Board<Magic>::compute_occupancy(board, occupancy);
+    Board<Magic>::compute_mailbox(board, mailbox);
+    pseudolegal_moves(moves, board, occupancy, mailbox, color, crs, eps, GEN_ALL);
+}
+
+/// @brief Generate pseudolegal moves with the occupancy and mailbox already known
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param moves move list to fill
+/// @param board bitboard array of all pieces
+/// @param occupancy occupancy bitboards by color, index NO_COLOR holds every piece
+/// @param mailbox piece index on each square, 255 for empty squares
+/// @param color player to generate moves
+/// @param crs castling rights
+/// @param eps en passant square
+/// @param gen_type kind of moves to generate
+template <typename Magic>
+void MoveGenerator<Magic>::pseudolegal_moves(MoveList &moves, Bitboard board[], Bitboard occupancy[], u8 mailbox[], Color color, CastlingRights crs, u8 eps, GenType gen_type){
+    moves.clear();
     int opp_pawn = NO_PIECE+((color^1)*6);
     int pawn = NO_PIECE+(color*6);
     int knight = pawn+1;
@@ -392,251 +454,363 @@ vector<Move> MoveGenerator<Magic>::pseudolegal_moves(Bitboard board[], Color col
     int queen = rook+1;
     int king = queen+1;
 
-    Bitboard all_pieces = 0, empty_pieces, opp_pieces = 0, en_passant_bb = (eps != 255) ? (1ULL << eps) : 0;
-    for(int i = NO_PIECE; i < WHITE_KING; i++){
-        all_pieces |= board[i];
-    }
-    for(int i = (color ? NO_PIECE : BLACK_KING); i < (color ? BLACK_KING : WHITE_KING); i++){
-        opp_pieces |= board[i];
-    }
-    empty_pieces = ~all_pieces;
+    Bitboard all_pieces = occupancy[NO_COLOR], empty_pieces = ~all_pieces, opp_pieces = occupancy[color^1], en_passant_bb = (eps != 255) ? (1ULL << eps) : 0;
 
-    generate_pawn_moves(moves, board, color, pawn, opp_pawn, opp_pieces, empty_pieces, en_passant_bb);
+    generate_pawn_moves(moves, gen_type, board, mailbox, color, pawn, opp_pawn, opp_pieces, empty_pieces, en_passant_bb);
     
-    generate_knight_moves(moves, board, knight, opp_pawn, opp_pieces, empty_pieces);
+    generate_knight_moves(moves, gen_type, board, mailbox, knight, opp_pawn, opp_pieces, empty_pieces);
     
-    generate_sliding_moves(moves, board, color, bishop, opp_pawn, opp_pieces, empty_pieces);
-    generate_sliding_moves(moves, board, color, queen, opp_pawn, opp_pieces, empty_pieces);
-    generate_sliding_moves(moves, board, color, rook, opp_pawn, opp_pieces, empty_pieces);
+    generate_sliding_moves(moves, gen_type, board, mailbox, color, bishop, opp_pawn, opp_pieces, empty_pieces);
+    generate_sliding_moves(moves, gen_type, board, mailbox, color, queen, opp_pawn, opp_pieces, empty_pieces);
+    generate_sliding_moves(moves, gen_type, board, mailbox, color, rook, opp_pawn, opp_pieces, empty_pieces);
     
-    generate_king_moves(moves, board, color, king, opp_pawn, all_pieces, opp_pieces, empty_pieces, crs);
-
-    return moves;
+    generate_king_moves(moves, gen_type, board, mailbox, color, king, opp_pawn, all_pieces, opp_pieces, empty_pieces, crs);
 }
 
 /// @brief Generate legal moves
 /// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param moves move list to fill
 /// @param board bitboard array of all pieces
 /// @param color player to generate moves
 /// @param crs castling rights
 /// @param eps en passant square
-/// @return list of legal moves
 template <typename Magic>
-vector<Move> MoveGenerator<Magic>::legal_moves(Bitboard board[], Color color, CastlingRights crs, u8 eps){
-    vector<Move> legal, moves = pseudolegal_moves(board, color, crs, eps);
-    
-    for(Move move: moves){
-        CastlingRights cr = crs;
-        u8 ep = eps;
-        Bitboard board_copy[12];
-        memcpy(board_copy, board, 12*sizeof(Bitboard));
-        Board<Magic>::do_move(board_copy, move, color, cr, ep);
-
-        Bitboard empty_pieces = 0;
-        for(int i = NO_PIECE; i < WHITE_KING; i++){
-            empty_pieces |= board_copy[i];
-        }
-        empty_pieces = ~empty_pieces;
+void MoveGenerator<Magic>::legal_moves(MoveList &moves, Bitboard board[], Color color, CastlingRights crs, u8 eps){
+    Bitboard occupancy[3];
+    u8 mailbox[64];
+    Board<Magic>::compute_occupancy(board, occupancy);
+    Board<Magic>::compute_mailbox(board, mailbox);
+    legal_moves(moves, board, occupancy, mailbox, color, crs, eps);
+}
 
-        if(!in_check(board_copy, empty_pieces, color)){
-            legal.push_back(move);
-        }
+/// @brief Generate legal moves with the occupancy and mailbox already known
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param moves move list to fill
+/// @param board bitboard array of all pieces
+/// @param occupancy occupancy bitboards by color, index NO_COLOR holds every piece
+/// @param mailbox piece index on each square, 255 for empty squares
+/// @param color player to generate moves
+/// @param crs castling rights
+/// @param eps en passant square
+template <typename Magic>
+void MoveGenerator<Magic>::legal_moves(MoveList &moves, Bitboard board[], Bitboard occupancy[], u8 mailbox[], Color color, CastlingRights crs, u8 eps){
+    Bitboard checkers = attackers_to(__builtin_ctzll(board[(color ? WHITE_KING-1 : BLACK_KING-1)]), board, occupancy[NO_COLOR], color);
+    generate_legal_moves(moves, board, occupancy, mailbox, checkers, color, crs, eps, GEN_ALL);
+}
 
-        // Board<Magic>::undo_move(board_copy, move, color, cr, ep, crs, eps);
-    }
+/// @brief Generate legal moves of a position, the checkers are taken from its state
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param moves move list to fill
+/// @param pos position to generate moves for
+template <typename Magic>
+void MoveGenerator<Magic>::legal_moves(MoveList &moves, Position<Magic> &pos){
+    generate_legal_moves(moves, pos.board, pos.occupancy, pos.mailbox, pos.st->checkers, pos.player, pos.st->castling_rights, pos.st->en_passant, GEN_ALL);
+}
 
-    return legal;
+/// @brief Generate one kind of legal moves of a position
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param moves move list to fill
+/// @param pos position to generate moves for
+/// @param gen_type kind of moves to generate
+template <typename Magic>
+void MoveGenerator<Magic>::legal_moves(MoveList &moves, Position<Magic> &pos, GenType gen_type){
+    generate_legal_moves(moves, pos.board, pos.occupancy, pos.mailbox, pos.st->checkers, pos.player, pos.st->castling_rights, pos.st->en_passant, gen_type);
 }
 
-/// @brief Filter move list to contain only captures
+/// @brief Check if the player to move has any legal move, stopping at the first one found
 /// @tparam Magic the type of magic the move generator is using, see config.h
-/// @param moves list of moves
-/// @return list of captures moves
+/// @param pos position to check
+/// @return true if there is a legal move, false on mate or stalemate
 template <typename Magic>
-vector<Move> MoveGenerator<Magic>::captures_moves(vector<Move> moves){
-    vector<Move> captures;
-    
-    for(Move move: moves){
-        if(move.capture_piece != 255){
-            captures.push_back(move);
+bool MoveGenerator<Magic>::has_legal_move(Position<Magic> &pos){
+    Color color = pos.player;
+    Bitboard king_bb = pos.board[(color ? WHITE_KING-1 : BLACK_KING-1)];
+    u8 king_square = __builtin_ctzll(king_bb);
+
+    // Most positions have a safe king step, which avoids generating the moves
+    Bitboard steps = get_attack_king(king_square) & ~pos.occupancy[color];
+    Bitboard empty_pieces = ~(pos.occupancy[NO_COLOR] ^ king_bb);
+    while(steps){
+        u8 square = __builtin_ctzll(steps);
+        steps &= steps-1;
+        if(!is_square_attacked(square, pos.board, empty_pieces, color)){
+            return true;
         }
     }
 
-    return captures;
+    MoveList moves;
+    legal_moves(moves, pos);
+    return moves.size() > 0;
 }
 
-/// @brief Filter move list to contain only promotions
+/// @brief Get the move of a position a packed move stands for, without generating the other moves.
+/// Used for hash and killer moves, which may come from another position
 /// @tparam Magic the type of magic the move generator is using, see config.h
-/// @param moves list of moves
-/// @return list of promotions moves
+/// @param pos position the move is played in
+/// @param packed packed move
+/// @param move move with the piece and capture taken from the position
+/// @return true if the move is legal in the position, false otherwise
 template <typename Magic>
-vector<Move> MoveGenerator<Magic>::promotions_moves(vector<Move> moves){
-    vector<Move> promotions;
-    
-    for(Move move: moves){
-        if(move.promotion_piece != 255 || move.promotion_piece != 0){
-            promotions.push_back(move);
+bool MoveGenerator<Magic>::get_legal_move(Position<Magic> &pos, PackedMove packed, Move &move){
+    if(packed.empty()){
+        return false;
+    }
+    Color color = pos.player;
+    u8 from = packed.get_from(), to = packed.get_to(), special = packed.get_special();
+    u8 piece = pos.mailbox[from], target = pos.mailbox[to];
+    int opp_pawn = (color ? 0 : 6), own_pawn = (color ? 6 : 0);
+    if(piece == 255 || (piece >= 6) != (color == WHITE) || (target != 255 && ((target >= 6) == (color == WHITE) || target == opp_pawn+KING-1))){
+        return false;
+    }
+
+    // Castling and en passant are rare, look them up in the generated moves
+    if(special == CASTLING_MOVE || special == EN_PASSANT_MOVE){
+        MoveList moves;
+        legal_moves(moves, pos, (special == CASTLING_MOVE) ? GEN_QUIETS : GEN_CAPTURES);
+        if(moves.move_to_front(packed)){
+            move = moves[0];
+            return true;
         }
+        return false;
     }
 
-    return promotions;
+    Bitboard from_bb = (1ULL << from), to_bb = (1ULL << to), all_pieces = pos.occupancy[NO_COLOR];
+    Bitboard last_rank = (color == WHITE ? RANK_8 : RANK_1);
+    u8 promotion_piece = 255;
+    if(piece == own_pawn){
+        if(((to_bb & last_rank) != 0) != (special == PROMOTION_MOVE)){
+            return false;
+        }
+        Bitboard attacks = shift((from_bb & ~0x0101010101010101), (color ? -9 : 7)) | shift((from_bb & ~0x8080808080808080), (color ? -7 : 9));
+        Bitboard single_push = shift(from_bb, (color ? -8 : 8)) & ~all_pieces;
+        Bitboard double_push = shift(single_push & (color ? RANK_3 : RANK_6), (color ? -8 : 8)) & ~all_pieces;
+        if(!((attacks & to_bb & pos.occupancy[color^1]) || ((single_push | double_push) & to_bb))){
+            return false;
+        }
+        promotion_piece = (special == PROMOTION_MOVE) ? packed.get_promotion() : 0;
+    }else{
+        if(special == PROMOTION_MOVE){
+            return false;
+        }
+        Bitboard attacks;
+        switch(piece - own_pawn + 1){
+            case KNIGHT: attacks = get_attack_knight(from); break;
+            case BISHOP: attacks = get_attack_bishop(from, all_pieces); break;
+            case ROOK: attacks = get_attack_rook(from, all_pieces); break;
+            case QUEEN: attacks = get_attack_bishop(from, all_pieces) | get_attack_rook(from, all_pieces); break;
+            default: attacks = get_attack_king(from); break;
+        }
+        if(!(attacks & to_bb)){
+            return false;
+        }
+    }
+    move = create_move(from, to, piece, target, promotion_piece, 0, 0);
+    // Unused promotion bits make a different packed move
+    if(pack_move(move) != packed){
+        return false;
+    }
+
+    // Same tests as generate_legal_moves, done for a single move
+    Bitboard king_bb = pos.board[own_pawn+KING-1];
+    Bitboard checkers = pos.st->checkers;
+    if(piece == own_pawn+KING-1){
+        return !is_square_attacked(to, pos.board, ~(all_pieces ^ king_bb), color);
+    }
+    u8 king_square = __builtin_ctzll(king_bb);
+    if(checkers){
+        if(checkers & (checkers-1)){
+            return false;
+        }
+        if(!(to_bb & (checkers | between(king_square, __builtin_ctzll(checkers))))){
+            return false;
+        }
+    }
+    // A slider that sees the king once the piece has moved means the piece was pinned
+    Bitboard occupied = (all_pieces ^ from_bb) | to_bb;
+    Bitboard snipers = (
+        (get_attack_rook(king_square, occupied) & (pos.board[opp_pawn+ROOK-1] | pos.board[opp_pawn+QUEEN-1])) |
+        (get_attack_bishop(king_square, occupied) & (pos.board[opp_pawn+BISHOP-1] | pos.board[opp_pawn+QUEEN-1]))
+    );
+    return (snipers & ~to_bb) == 0;
 }
 
-/// @brief Order moves to contain {captures, promotions, non_captures}
+/// @brief Generate legal moves, the pins and the check evasion mask are computed once and the pseudolegal moves are
+/// filtered with them, only king moves and en passant captures need an attack test
 /// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param moves move list to fill
 /// @param board bitboard array of all pieces
-/// @param moves list of moves
-/// @param cr castling rights
-/// @param ep en passant square
-/// @param color player to order moves
-/// @param captures_only get only capture, promotions and check moves
-/// @return list of ordered moves
-template <typename Magic>
-vector<Move> MoveGenerator<Magic>::order_moves(Bitboard board[], vector<Move> moves, Color color, bool captures_only){
-    vector<Move> captures = captures_moves(moves);
-    vector<Move> promotions = promotions_moves(moves);
-    vector<Move> ordered;
-    ordered.reserve(captures.size());
-    
-    int capture_evals[captures.size()];
-    int i = 0;
-    for(Move m : captures){
-        m.idx = i;
-        capture_evals[m.idx] = 100*material_value[m.capture_piece] - material_value[m.piece];
-        i++;
-    }
-    sort(captures.begin(), captures.end(), [this, &capture_evals](const Move &a, const Move &b){
-        return capture_evals[a.idx] > capture_evals[b.idx];
-    });
-
-    for(Move move: captures){
-        ordered.push_back(move);
+/// @param occupancy occupancy bitboards by color, index NO_COLOR holds every piece
+/// @param mailbox piece index on each square, 255 for empty squares
+/// @param checkers opponent pieces giving check
+/// @param color player to generate moves
+/// @param crs castling rights
+/// @param eps en passant square
+/// @param gen_type kind of moves to generate
+template <typename Magic>
+void MoveGenerator<Magic>::generate_legal_moves(MoveList &moves, Bitboard board[], Bitboard occupancy[], u8 mailbox[], Bitboard checkers, Color color, CastlingRights crs, u8 eps, GenType gen_type){
+    int opp_pawn = (color ? 0 : 6), king = (color ? WHITE_KING-1 : BLACK_KING-1);
+    u8 king_square = __builtin_ctzll(board[king]);
+    Bitboard king_bb = board[king];
+
+    // Squares a non king move has to land on, the checker or the squares blocking it
+    Bitboard evasion_mask = ~0ULL;
+    if(checkers){
+        int checker = __builtin_ctzll(checkers);
+        evasion_mask = checkers | between(king_square, checker);
     }
-
-    if(promotions.size() > 0){
-        int promotion_evals[promotions.size()];
-        i = 0;
-        for(Move m : promotions){
-            m.idx = i;
-            promotion_evals[m.idx] = material_value[m.promotion_piece];
-            i++;
+    bool double_check = (checkers & (checkers-1)) != 0;
+
+    // Pieces pinned to the king can only move along the line to the pinning piece
+    Bitboard pinned = 0;
+    Bitboard pin_ray[64];
+    Bitboard snipers = (
+        (get_attack_rook(king_square, occupancy[color^1]) & (board[opp_pawn+ROOK-1] | board[opp_pawn+QUEEN-1])) |
+        (get_attack_bishop(king_square, occupancy[color^1]) & (board[opp_pawn+BISHOP-1] | board[opp_pawn+QUEEN-1]))
+    );
+    while(snipers){
+        int sniper = __builtin_ctzll(snipers);
+        snipers &= snipers-1;
+        Bitboard ray = between(king_square, sniper);
+        Bitboard blockers = ray & occupancy[NO_COLOR];
+        if(blockers && (blockers & (blockers-1)) == 0 && (blockers & occupancy[color])){
+            pinned |= blockers;
+            pin_ray[__builtin_ctzll(blockers)] = ray | (1ULL << sniper);
         }
-        sort(promotions.begin(), promotions.end(), [this, &promotion_evals](const Move &a, const Move &b){
-            return promotion_evals[a.idx] > promotion_evals[b.idx];
-        });
-    
-        for(Move move: promotions){
-            ordered.push_back(move);
+    }
+
+    // Squares a non capture has to land on to give a direct check, by piece type, and own pieces uncovering
+    // a slider on the opponent king when leaving the line to it
+    Bitboard check_squares[6] = {0}, discoverers = 0;
+    Bitboard discover_ray[64];
+    if(gen_type == GEN_CAPTURES_CHECKS){
+        int own_pawn = (color ? 6 : 0);
+        u8 opp_king_square = __builtin_ctzll(board[opp_pawn+KING-1]);
+        Bitboard opp_king_bb = board[opp_pawn+KING-1];
+        check_squares[PAWN-1] = shift((opp_king_bb & ~0x0101010101010101), (color ? 7 : -9)) | shift((opp_king_bb & ~0x8080808080808080), (color ? 9 : -7));
+        check_squares[KNIGHT-1] = get_attack_knight(opp_king_square);
+        check_squares[BISHOP-1] = get_attack_bishop(opp_king_square, occupancy[NO_COLOR]);
+        check_squares[ROOK-1] = get_attack_rook(opp_king_square, occupancy[NO_COLOR]);
+        check_squares[QUEEN-1] = check_squares[BISHOP-1] | check_squares[ROOK-1];
+
+        Bitboard discover_snipers = (
+            (get_attack_rook(opp_king_square, occupancy[color^1]) & (board[own_pawn+ROOK-1] | board[own_pawn+QUEEN-1])) |
+            (get_attack_bishop(opp_king_square, occupancy[color^1]) & (board[own_pawn+BISHOP-1] | board[own_pawn+QUEEN-1]))
+        );
+        while(discover_snipers){
+            int sniper = __builtin_ctzll(discover_snipers);
+            discover_snipers &= discover_snipers-1;
+            Bitboard ray = between(opp_king_square, sniper);
+            Bitboard blockers = ray & occupancy[NO_COLOR];
+            if(blockers && (blockers & (blockers-1)) == 0 && (blockers & occupancy[color])){
+                discoverers |= blockers;
+                discover_ray[__builtin_ctzll(blockers)] = ray;
+            }
         }
     }
 
-    vector<Move> non_captures; non_captures.reserve(moves.size()-captures.size());
+    // The pseudolegal moves are filtered in place
+    pseudolegal_moves(moves, board, occupancy, mailbox, color, crs, eps, (gen_type == GEN_CAPTURES_CHECKS) ? GEN_ALL : gen_type);
+    int legal = 0;
     for(Move move: moves){
-        if(captures_only){
-            if(move.capture_piece == 255 && (move.promotion_piece == 255 || move.promotion_piece == 0)){
-                CastlingRights cr = NO_CASTLING;
-                u8 ep = 255;
-                Bitboard board_copy[12];
-                memcpy(board_copy, board, 12*sizeof(Bitboard));
-                Board<Magic>::do_move(board_copy, move, color, cr, ep);
-
-                Bitboard empty_pieces = 0;
-                for(int i = NO_PIECE; i < WHITE_KING; i++){
-                    empty_pieces |= board_copy[i];
-                }
-                empty_pieces = ~empty_pieces;
-
-                if(in_check(board_copy, empty_pieces, Color(color^1))){
-                    non_captures.push_back(move);
-                }
+        Bitboard to = (1ULL << move.to);
+        if(gen_type == GEN_CAPTURES_CHECKS && move.capture_piece == 255 && (move.promotion_piece == 255 || move.promotion_piece == 0)){
+            bool direct = (to & check_squares[move.piece - (color ? 6 : 0)]) != 0;
+            bool discovered = (discoverers & (1ULL << move.from)) && !(to & discover_ray[move.from]);
+            if(move.get_castling() != 0 || !(direct || discovered)){
+                continue;
             }
-        }else{
-            non_captures.push_back(move);
         }
+        if(move.piece == king){
+            // Castling squares are already checked by the generator
+            if(move.get_castling() == 0 && is_square_attacked(move.to, board, ~(occupancy[NO_COLOR] ^ king_bb), color)){
+                continue;
+            }
+        }else if(double_check){
+            continue;
+        }else if(in_range(move.get_en_passant(), 16, 47)){
+            // The captured pawn leaves the board too, which can uncover a slider on the king's rank
+            Bitboard board_copy[12];
+            memcpy(board_copy, board, 12*sizeof(Bitboard));
+            CastlingRights cr = crs;
+            u8 ep = eps;
+            Board<Magic>::do_move(board_copy, move, color, cr, ep);
+            Bitboard captured = (1ULL << (move.get_en_passant()+(color ? 8 : -8)));
+            Bitboard all_pieces = (occupancy[NO_COLOR] ^ (1ULL << move.from) ^ captured) | to;
+            if(in_check(board_copy, ~all_pieces, color)){
+                continue;
+            }
+        }else if(!(to & evasion_mask) || ((pinned & (1ULL << move.from)) && !(to & pin_ray[move.from]))){
+            continue;
+        }
+        moves[legal++] = move;
     }
-    ordered.reserve(ordered.size()+non_captures.size());
+    moves.resize(legal);
+}
 
-    int evals[non_captures.size()];
-    i = 0;
-    for(Move m : non_captures){
-        m.idx = i;
-        evals[m.idx] = history[color][m.from][m.to];
-        i++;
+/// @brief Order moves to contain {captures, promotions, non_captures}, the list is sorted in place
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param moves list of moves
+/// @param color player to order moves
+template <typename Magic>
+void MoveGenerator<Magic>::order_moves(MoveList &moves, Color color){
+    // Each move gets a group (0 captures, 1 promotions, 2 non captures) and a score inside of it
+    u8 groups[MAX_MOVES];
+    int evals[MAX_MOVES];
+    for(int i = 0; i < moves.size(); i++){
+        Move &move = moves[i];
+        move.idx = i;
+        if(move.capture_piece != 255){
+            groups[i] = 0;
+            evals[i] = 100*material_value[move.capture_piece] - material_value[move.piece];
+        }else if(move.promotion_piece != 255 && move.promotion_piece != 0){
+            groups[i] = 1;
+            evals[i] = material_value[move.promotion_piece];
+        }else{
+            groups[i] = 2;
+            evals[i] = history[color][move.from][move.to];
+        }
     }
-    sort(non_captures.begin(), non_captures.end(), [this, &evals](const Move &a, const Move &b){
+
+    sort(moves.begin(), moves.end(), [&groups, &evals](const Move &a, const Move &b){
+        if(groups[a.idx] != groups[b.idx]){
+            return groups[a.idx] < groups[b.idx];
+        }
         return evals[a.idx] > evals[b.idx];
     });
-
-    for(Move move: non_captures){
-        ordered.push_back(move);
-    }
-
-    return ordered;
 }
 
 /// @brief Start perft test
 /// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param depth depth to check
-/// @param board bitboard array of all pieces
-/// @param tt reference to transposition table object
-/// @param color player to start the test from
-/// @param crs castling rights
-/// @param eps en passant square
-/// @param piece_zob use fast update on the zobrist key
-/// @param use_loop update zobrist key looping through all bitboards
+/// @param pos position to start the test from, moves are made and taken back on it
+/// @param tt reference to the perft table object
 /// @return amount of nodes in the perft test
 template <typename Magic>
-u64 MoveGenerator<Magic>::perft(int depth, Bitboard board[], Color color, TT &tt, CastlingRights &crs, uint8_t &eps, u64 *piece_zob, bool use_loop){
+u64 MoveGenerator<Magic>::perft(int depth, Position<Magic> &pos, PerftTT &tt){
     if(depth == 0){
         return 1ULL;
     }
+
+    MoveList moves;
+    // Count the leaves without making them
+    if(depth == 1){
+        legal_moves(moves, pos);
+        return moves.size();
+    }
     
-    u64 key = zob_key(*zobrist_table, board, color, crs, eps, piece_zob, use_loop);
-    Entry curr_entry = tt.atomic_read(key);
-    if(curr_entry.depth == depth && curr_entry.is_board_equal(key)){
-        return curr_entry.count;
+    u64 nodes = 0;
+    if(tt.probe(pos.st->key, depth, nodes)){
+        return nodes;
     }
 
-    u64 nodes = 0;
-    vector<Move> moves = pseudolegal_moves(board, color, crs, eps);
-    Bitboard board_copy[12];
+    legal_moves(moves, pos);
     for(Move move: moves){
-        memcpy(board_copy, board, 12*sizeof(Bitboard));
-        CastlingRights cr = crs;
-        uint8_t ep = eps;
-
-        Board<Magic>::do_move(board_copy, move, color, cr, ep);
-
-        Bitboard empty_pieces = 0;
-        for(int i = NO_PIECE; i < WHITE_KING; i++){
-            empty_pieces |= board_copy[i];
-        }
-        empty_pieces = ~empty_pieces;
-
-        u64 aux = 0;
-        if(piece_zob != NULL && !use_loop){
-            aux = (*piece_zob);
-            if(in_range(move.get_en_passant(), 16, 47)){
-                (*piece_zob) ^= (*zobrist_table)[move.capture_piece*64+(move.get_en_passant()+(color ? 8 : -8))];
-            }else if(move.capture_piece != 255 && move.promotion_piece == 0){
-                (*piece_zob) ^= (*zobrist_table)[move.capture_piece*64+move.to];
-            }
-            if(move.promotion_piece != 255){
-                (*piece_zob) ^= (*zobrist_table)[move.promotion_piece*64+move.to];
-            }
-            (*piece_zob) ^= (*zobrist_table)[move.piece*64+move.from];
-        }
-
-        if(!in_check(board_copy, empty_pieces, color)){
-            nodes += perft(depth-1, board_copy, Color(color^1), tt, cr, ep, piece_zob, false);
-        }
-
-        if(piece_zob != NULL && !use_loop){
-            (*piece_zob) = aux;
-        }
+        pos.do_move(move);
+        nodes += perft(depth-1, pos, tt);
+        pos.undo_move(move);
     }
 
-    tt.add(key, Entry(depth, nodes, key));
+    tt.store(pos.st->key, depth, nodes);
     
     return nodes;
 }
@@ -644,54 +818,22 @@ u64 MoveGenerator<Magic>::perft(int depth, Bitboard board[], Color color, TT &tt
 /// @brief Start parallelized perft test
 /// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param depth depth to check
-/// @param board bitboard array of all pieces
-/// @param color player to start the test from
-/// @param castling castling rights
-/// @param en_passant en passant square
-/// @param tt reference to transposition table object
-/// @param use_piece_zob use fast update on the zobrist key
+/// @param pos position to start the test from, each root move is searched on a copy
+/// @param tt reference to the perft table object
 /// @return amount of nodes in the perft test
 template <typename Magic>
-u64 MoveGenerator<Magic>::perft_parallel(int depth, Bitboard board[], Color color, CastlingRights castling, u8 en_passant, TT &tt, bool use_piece_zob){
-    if(depth == 0) return legal_moves(board, color, castling, en_passant).size();
+u64 MoveGenerator<Magic>::perft_parallel(int depth, Position<Magic> &pos, PerftTT &tt){
+    MoveList moves;
+    legal_moves(moves, pos);
+    if(depth == 0) return moves.size();
 
-    Bitboard boards_copy[num_threads][12];
-    u64 pieces_zob[num_threads];
-    memset(pieces_zob, 0, sizeof(u64)*num_threads);
-    CastlingRights crs[num_threads];
-    u8 eps[num_threads];
-    for(int i = 0; i < num_threads; i++){
-        memcpy(boards_copy[i], board, 12*sizeof(Bitboard));
-        crs[i] = castling;
-        eps[i] = en_passant;
-    }
-    
     u64 nodes = 0;
-    vector<Move> moves = pseudolegal_moves(board, color, castling, en_passant);
     #pragma omp parallel for num_threads(num_threads) reduction(+:nodes)
-    for(Move move: moves){
-        int idx = omp_get_thread_num();
-
-        Bitboard board_copy[12];
-        memcpy(board_copy, boards_copy[idx], 12*sizeof(Bitboard));
-        CastlingRights cr = crs[idx];
-        u8 ep = eps[idx];
-
-        Board<Magic>::do_move(board_copy, move, color, cr, ep);
-
-        Bitboard empty_pieces = 0;
-        for(int i = NO_PIECE; i < WHITE_KING; i++){
-            empty_pieces |= board_copy[i];
-        }
-        empty_pieces = ~empty_pieces;
-
-        if(!in_check(board_copy, empty_pieces, color)){
-            if(use_piece_zob){
-                nodes += perft(depth-1, board_copy, Color(color^1), tt, cr, ep, (pieces_zob+idx), use_piece_zob);
-            }else{
-                nodes += perft(depth-1, board_copy, Color(color^1), tt, cr, ep, NULL, false);
-            }
-        }
+    for(int i = 0; i < moves.size(); i++){
+        Position<Magic> *child = new Position<Magic>(pos);
+        child->do_move(moves[i]);
+        nodes += perft(depth-1, *child, tt);
+        delete child;
     }
 
     return nodes;
@@ -4,15 +4,18 @@
 #include "config.h"
 #include "types.h"
 #include "transposition_table.h"
+#include "perft_table.h"
 #include "entry.h"
 #include "zobrist.h"
 #include <omp.h>
-#include <vector>
 
 using namespace std;
 
 namespace arapaimachess{
 
+template <typename Magic>
+class Position;
+
 template <typename Magic>
 class MoveGenerator{
     private:
@@ -25,8 +28,10 @@ class MoveGenerator{
         MoveGenerator(Zobrist *zorist_table, Magic *magic, int num_threads);
         ~MoveGenerator() = default;
 
+        void set_threads(int threads);
         void reset_history();
         void add_history(Color player, Move move, int depth);
+        int get_history(Color player, Move move);
 
         Bitboard get_attack_rook(int sq, Bitboard occ);
         Bitboard get_attack_bishop(int sq, Bitboard occ);
@@ -36,27 +41,34 @@ class MoveGenerator{
         bool sliding_attack(Bitboard board, Bitboard opp_pieces, Bitboard empty_pieces, PieceType pc);
         bool is_square_attacked(u8 square, Bitboard board[], Bitboard empty_pieces, Color color);
         bool in_check(Bitboard board[], Bitboard empty_pieces, Color color);
+        Bitboard attackers_to(u8 square, Bitboard board[], Bitboard all_pieces, Color color);
+        Bitboard between(u8 from, u8 to);
 
-        void extract_pawn_captures(vector<Move> &orig, Bitboard boards[], Bitboard board, int offset, u8 opp_pawn, u8 piece, u8 promotion_piece, u8 passant);
-        void extract_pawn_moves(vector<Move> &orig, Bitboard board, int offset, u8 piece, u8 promotion_piece);
-        void extract_capture_moves(vector<Move> &orig, Bitboard boards[], Bitboard board, u8 from, u8 opp_pawn, u8 piece);
-        void extract_moves(vector<Move> &orig, Bitboard board, u8 from, u8 piece);
+        void extract_pawn_captures(MoveList &orig, u8 mailbox[], Bitboard board, int offset, u8 opp_pawn, u8 piece, u8 promotion_piece, u8 passant);
+        void extract_pawn_moves(MoveList &orig, Bitboard board, int offset, u8 piece, u8 promotion_piece);
+        void extract_capture_moves(MoveList &orig, u8 mailbox[], Bitboard board, u8 from, u8 opp_pawn, u8 piece);
+        void extract_moves(MoveList &orig, Bitboard board, u8 from, u8 piece);
 
-        void generate_pawn_moves(vector<Move> &moves, Bitboard board[], Color color, int index, int opp_pawn, Bitboard opp_pieces, Bitboard empty_pieces, Bitboard en_passant_bb);
-        void generate_knight_moves(vector<Move> &moves, Bitboard board[], int piece_index, int opp_pawn, Bitboard opp_pieces, Bitboard empty_pieces);
-        void generate_king_moves(vector<Move> &moves, Bitboard board[], Color color, int piece_index, int opp_pawn, Bitboard all_pieces, Bitboard opp_pieces, Bitboard empty_pieces, CastlingRights crs);
-        void generate_sliding_moves(vector<Move> &moves, Bitboard board[], Color color, int piece_index, int opp_pawn, Bitboard opp_pieces, Bitboard empty_pieces);
+        void generate_pawn_moves(MoveList &moves, GenType gen_type, Bitboard board[], u8 mailbox[], Color color, int index, int opp_pawn, Bitboard opp_pieces, Bitboard empty_pieces, Bitboard en_passant_bb);
+        void generate_knight_moves(MoveList &moves, GenType gen_type, Bitboard board[], u8 mailbox[], int piece_index, int opp_pawn, Bitboard opp_pieces, Bitboard empty_pieces);
+        void generate_king_moves(MoveList &moves, GenType gen_type, Bitboard board[], u8 mailbox[], Color color, int piece_index, int opp_pawn, Bitboard all_pieces, Bitboard opp_pieces, Bitboard empty_pieces, CastlingRights crs);
+        void generate_sliding_moves(MoveList &moves, GenType gen_type, Bitboard board[], u8 mailbox[], Color color, int piece_index, int opp_pawn, Bitboard opp_pieces, Bitboard empty_pieces);
         
-        vector<Move> pseudolegal_moves(Bitboard board[], Color color, CastlingRights crs, u8 eps);
-        vector<Move> legal_moves(Bitboard board[], Color color, CastlingRights crs, u8 eps);
+        void pseudolegal_moves(MoveList &moves, Bitboard board[], Color color, CastlingRights crs, u8 eps);
+        void pseudolegal_moves(MoveList &moves, Bitboard board[], Bitboard occupancy[], u8 mailbox[], Color color, CastlingRights crs, u8 eps, GenType gen_type);
+        void legal_moves(MoveList &moves, Bitboard board[], Color color, CastlingRights crs, u8 eps);
+        void legal_moves(MoveList &moves, Bitboard board[], Bitboard occupancy[], u8 mailbox[], Color color, CastlingRights crs, u8 eps);
+        void legal_moves(MoveList &moves, Position<Magic> &pos);
+        void legal_moves(MoveList &moves, Position<Magic> &pos, GenType gen_type);
+        bool get_legal_move(Position<Magic> &pos, PackedMove packed, Move &move);
+        bool has_legal_move(Position<Magic> &pos);
+        void generate_legal_moves(MoveList &moves, Bitboard board[], Bitboard occupancy[], u8 mailbox[], Bitboard checkers, Color color, CastlingRights crs, u8 eps, GenType gen_type);
 
-        vector<Move> captures_moves(vector<Move> moves);
-        vector<Move> promotions_moves(vector<Move> moves);
-        vector<Move> order_moves(Bitboard board[], vector<Move> moves, Color color, bool captures_only);
+        void order_moves(MoveList &moves, Color color);
 
-        u64 perft(int depth, Bitboard board[], Color color, TT &tt, CastlingRights &crs, uint8_t &eps, u64 *piece_zob, bool use_loop);
+        u64 perft(int depth, Position<Magic> &pos, PerftTT &tt);
 
-        u64 perft_parallel(int depth, Bitboard board[], Color color, CastlingRights cr, u8 ep, TT &tt, bool use_piece_zob);
+        u64 perft_parallel(int depth, Position<Magic> &pos, PerftTT &tt);
 };
 
 }
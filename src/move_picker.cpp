@@ -0,0 +1,131 @@
+#include "move_picker.h"
+#include "evaluate.h"
+#include "./magics/pext.h"
+#include "./magics/fixed.h"
+
+using namespace std;
+
+namespace arapaimachess{
+
+/// @brief Create a MovePicker object
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param move_generator reference to MoveGenerator object
+/// @param pos position to pick moves from
+/// @param hash_move move from the transposition table, tried before anything is generated
+/// @param killers the two killer moves of the current ply, tried after the captures
+template <typename Magic>
+MovePicker<Magic>::MovePicker(MoveGenerator<Magic> *move_generator, Position<Magic> *pos, PackedMove hash_move, PackedMove killers[]){
+    this->move_generator = move_generator;
+    this->pos = pos;
+    this->hash_move = hash_move;
+    this->killers[0] = killers[0];
+    this->killers[1] = killers[1];
+}
+
+/// @brief Skip the stages and pick the moves of a list filled by the caller, in its order
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @return list to fill with the moves
+template <typename Magic>
+MoveList& MovePicker<Magic>::use_list(){
+    this->stage = LIST_STAGE;
+    this->current = 0;
+    this->moves.clear();
+    return this->moves;
+}
+
+/// @brief Selection sort step, swap the best scored move left to the current position
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @return best move not picked yet
+template <typename Magic>
+Move MovePicker<Magic>::pick_best(){
+    int best = this->current;
+    for(int i = this->current+1; i < this->moves.size(); i++){
+        if(this->evals[i] > this->evals[best]){
+            best = i;
+        }
+    }
+    swap(this->moves[best], this->moves[this->current]);
+    swap(this->evals[best], this->evals[this->current]);
+    return this->moves[this->current++];
+}
+
+/// @brief Get the next move to search, in the order {hash move, captures and promotions, killers, non captures}
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param move next move
+/// @return true if there is a move, false when all moves were picked
+template <typename Magic>
+bool MovePicker<Magic>::next_move(Move &move){
+    switch(this->stage){
+        case HASH_STAGE:
+            this->stage = CAPTURES_INIT;
+            if(this->move_generator->get_legal_move(*this->pos, this->hash_move, move)){
+                return true;
+            }
+            [[fallthrough]];
+        case CAPTURES_INIT:
+            this->move_generator->legal_moves(this->moves, *this->pos, GEN_CAPTURES);
+            for(int i = 0; i < this->moves.size(); i++){
+                Move &m = this->moves[i];
+                if(m.capture_piece != 255){
+                    this->evals[i] = 100*material_value[m.capture_piece] - material_value[m.piece];
+                }else{
+                    this->evals[i] = material_value[m.promotion_piece];
+                }
+            }
+            this->current = 0;
+            this->stage = CAPTURES_STAGE;
+            [[fallthrough]];
+        case CAPTURES_STAGE:
+            while(this->current < this->moves.size()){
+                move = pick_best();
+                if(pack_move(move) != this->hash_move){
+                    return true;
+                }
+            }
+            this->killer_idx = 0;
+            this->stage = KILLERS_STAGE;
+            [[fallthrough]];
+        case KILLERS_STAGE:
+            // Killers come from sibling positions, captures and promotions were already picked above
+            while(this->killer_idx < 2){
+                PackedMove killer = this->killers[this->killer_idx++];
+                if(killer != this->hash_move && killer.get_special() != PROMOTION_MOVE && this->move_generator->get_legal_move(*this->pos, killer, move) && move.capture_piece == 255){
+                    return true;
+                }
+            }
+            this->stage = QUIETS_INIT;
+            [[fallthrough]];
+        case QUIETS_INIT:
+            this->move_generator->legal_moves(this->moves, *this->pos, GEN_QUIETS);
+            for(int i = 0; i < this->moves.size(); i++){
+                this->evals[i] = this->move_generator->get_history(this->pos->player, this->moves[i]);
+            }
+            this->current = 0;
+            this->stage = QUIETS_STAGE;
+            [[fallthrough]];
+        case QUIETS_STAGE:
+            while(this->current < this->moves.size()){
+                move = pick_best();
+                PackedMove packed = pack_move(move);
+                if(packed != this->hash_move && packed != this->killers[0] && packed != this->killers[1]){
+                    return true;
+                }
+            }
+            this->stage = DONE_STAGE;
+            return false;
+        case LIST_STAGE:
+            if(this->current < this->moves.size()){
+                move = this->moves[this->current++];
+                return true;
+            }
+            this->stage = DONE_STAGE;
+            return false;
+        default:
+            return false;
+    }
+}
+
+template class MovePicker<PEXT_Magic>;
+template class MovePicker<FIXED_Magic>;
+
+}
@@ -0,0 +1,50 @@
+#ifndef MOVEPICKER_H
+#define MOVEPICKER_H
+
+#include "config.h"
+#include "types.h"
+#include "move_generator.h"
+#include "position.h"
+
+using namespace std;
+
+namespace arapaimachess{
+
+enum PickStage: u8{
+    HASH_STAGE = 0,
+    CAPTURES_INIT,
+    CAPTURES_STAGE,
+    KILLERS_STAGE,
+    QUIETS_INIT,
+    QUIETS_STAGE,
+    LIST_STAGE,
+    DONE_STAGE
+};
+
+/// @brief Staged move generation for the search, each stage is only generated when the previous one is exhausted
+/// so a beta cutoff skips the generation of the remaining moves
+template <typename Magic>
+class MovePicker{
+    private:
+        MoveGenerator<Magic> *move_generator;
+        Position<Magic> *pos;
+        PackedMove hash_move;
+        PackedMove killers[2];
+        MoveList moves;
+        int evals[MAX_MOVES];
+        int current = 0;
+        int killer_idx = 0;
+        PickStage stage = HASH_STAGE;
+
+        Move pick_best();
+    public:
+        MovePicker(MoveGenerator<Magic> *move_generator, Position<Magic> *pos, PackedMove hash_move, PackedMove killers[]);
+        ~MovePicker() = default;
+
+        MoveList& use_list();
+        bool next_move(Move &move);
+};
+
+}
+
+#endif
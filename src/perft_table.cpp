@@ -0,0 +1,75 @@
+#include <cstdlib>
+#include <algorithm>
+#include <cstdint>
+
+#include "perft_table.h"
+
+using namespace std;
+
+namespace arapaimachess{
+
+// Data layout - count in the upper 56 bits, depth in the lower 8 bits (0 is an empty entry)
+#define PERFT_DEPTH_BITS 8
+#define PERFT_DEPTH_MASK 255
+
+/// @brief Create a perft table, allocated zeroed. The table is halved until the allocation succeeds,
+/// if not even one cluster can be allocated the embedded fallback cluster is used, which is the same as no table
+/// @param size size in number of entries, rounded down to a power of two
+PerftTT::PerftTT(u64 size){
+    u64 clusters = max(size / PERFT_CLUSTER_SIZE, 1ULL);
+    this->num_clusters = 1ULL << (63 - __builtin_clzll(clusters));
+    this->memory = calloc(this->num_clusters * sizeof(PerftCluster) + alignof(PerftCluster), 1);
+    while(this->memory == NULL && this->num_clusters > 1){
+        this->num_clusters >>= 1;
+        this->memory = calloc(this->num_clusters * sizeof(PerftCluster) + alignof(PerftCluster), 1);
+    }
+    if(this->memory == NULL){
+        this->num_clusters = 1;
+        this->clusters = &this->fallback;
+        return;
+    }
+    this->clusters = (PerftCluster *)(((uintptr_t)this->memory + alignof(PerftCluster) - 1) & ~(uintptr_t)(alignof(PerftCluster) - 1));
+}
+
+PerftTT::~PerftTT(){
+    free(this->memory);
+}
+
+/// @brief Look up the node count of a position at a given depth
+/// @param key zobrist key
+/// @param depth remaining depth
+/// @param count node count if found
+/// @return true if the position was found at that depth
+bool PerftTT::probe(u64 key, int depth, u64 &count) const {
+    const PerftCluster &cluster = this->clusters[key & (this->num_clusters - 1)];
+    for(int i = 0; i < PERFT_CLUSTER_SIZE; i++){
+        u64 data = cluster.entries[i].data.load(memory_order_relaxed);
+        if((data & PERFT_DEPTH_MASK) == (u64)depth && (cluster.entries[i].key_data.load(memory_order_relaxed) ^ data) == key){
+            count = data >> PERFT_DEPTH_BITS;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief Store the node count of a position, replacing the shallowest entry of the cluster
+/// @param key zobrist key
+/// @param depth remaining depth, between 1 and 255
+/// @param count node count
+void PerftTT::store(u64 key, int depth, u64 count){
+    PerftCluster &cluster = this->clusters[key & (this->num_clusters - 1)];
+    int replace = 0, replace_depth = PERFT_DEPTH_MASK + 1;
+    for(int i = 0; i < PERFT_CLUSTER_SIZE; i++){
+        u64 data = cluster.entries[i].data.load(memory_order_relaxed);
+        int entry_depth = data & PERFT_DEPTH_MASK;
+        if(entry_depth < replace_depth){
+            replace = i;
+            replace_depth = entry_depth;
+        }
+    }
+    u64 data = (count << PERFT_DEPTH_BITS) | (u64)(depth & PERFT_DEPTH_MASK);
+    cluster.entries[replace].data.store(data, memory_order_relaxed);
+    cluster.entries[replace].key_data.store(key ^ data, memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,39 @@
+#ifndef PERFT_TABLE_H
+#define PERFT_TABLE_H
+
+#include <atomic>
+#include "types.h"
+
+#define PERFT_CLUSTER_SIZE 4
+
+using namespace std;
+
+namespace arapaimachess{
+
+/// @brief Perft entry packed in 16 bytes, data holds the node count and the depth, key_data holds the key xored with data
+struct PerftEntry{
+    atomic<u64> key_data;
+    atomic<u64> data;
+};
+
+/// @brief Bucket of perft entries sharing the same index, sized to fit one cache line
+struct alignas(64) PerftCluster{
+    PerftEntry entries[PERFT_CLUSTER_SIZE];
+};
+
+class PerftTT{
+    private:
+        void *memory = NULL;
+        PerftCluster *clusters = NULL;
+        PerftCluster fallback = {};
+        u64 num_clusters;
+    public:
+        PerftTT(u64 size);
+        ~PerftTT();
+        bool probe(u64 key, int depth, u64 &count) const;
+        void store(u64 key, int depth, u64 count);
+};
+
+}
+
+#endif
@@ -0,0 +1,187 @@
+#include "position.h"
+#include "board.h"
+#include "utils.h"
+#include "./magics/pext.h"
+#include "./magics/fixed.h"
+#include <cstring>
+#include <cassert>
+
+using namespace std;
+
+namespace arapaimachess{
+
+template <typename Magic>
+Position<Magic>::Position(){}
+
+/// @brief Create a Position object, set must be called before making moves
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param zobrist_table reference to the Zobrist object
+/// @param move_generator reference to the MoveGenerator object, used for the attack tables
+template <typename Magic>
+Position<Magic>::Position(Zobrist *zobrist_table, MoveGenerator<Magic> *move_generator){
+    assert(zobrist_table != NULL && move_generator != NULL);
+    this->zobrist_table = zobrist_table;
+    this->move_generator = move_generator;
+    this->st = this->states;
+}
+
+/// @brief Copy a Position object, only the current state is copied so the copy can not undo the moves made before
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param other position to copy
+template <typename Magic>
+Position<Magic>::Position(const Position &other){
+    this->zobrist_table = other.zobrist_table;
+    this->move_generator = other.move_generator;
+    memcpy(this->board, other.board, 12*sizeof(Bitboard));
+    memcpy(this->occupancy, other.occupancy, 3*sizeof(Bitboard));
+    memcpy(this->mailbox, other.mailbox, 64*sizeof(u8));
+    this->player = other.player;
+    this->st = this->states;
+    *this->st = *other.st;
+}
+
+/// @brief Set the position, the state stack is reset
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param board bitboard array of all pieces
+/// @param player player to move
+/// @param cr castling rights
+/// @param ep en passant square
+/// @param rule50 rule 50 counter
+/// @param key zobrist key of the position
+template <typename Magic>
+void Position<Magic>::set(Bitboard board[], Color player, CastlingRights cr, u8 ep, unsigned int rule50, u64 key){
+    memcpy(this->board, board, 12*sizeof(Bitboard));
+    Board<Magic>::compute_occupancy(this->board, this->occupancy);
+    Board<Magic>::compute_mailbox(this->board, this->mailbox);
+    this->player = player;
+    this->st = this->states;
+    this->st->key = key;
+    this->st->rule50 = rule50;
+    this->st->castling_rights = cr;
+    this->st->en_passant = ep;
+    this->st->captured_piece = 255;
+    this->st->checkers = compute_checkers();
+    #if defined(NN_EVAL)
+        this->st->accumulator_ready = false;
+    #endif
+}
+
+/// @brief Get the opponent pieces giving check to the player to move
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @return bitboard of the checking pieces
+template <typename Magic>
+Bitboard Position<Magic>::compute_checkers(){
+    int square = __builtin_ctzll(board[(player ? WHITE_KING-1 : BLACK_KING-1)]);
+    return move_generator->attackers_to(square, board, occupancy[NO_COLOR], player);
+}
+
+/// @brief Make a move, the new state is pushed on the stack
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param move move to make
+template <typename Magic>
+void Position<Magic>::do_move(Move move){
+    assert(st - states < MAX_STATES - 1);
+    StateInfo *next = st + 1;
+    next->key = st->key;
+    next->castling_rights = st->castling_rights;
+    next->en_passant = st->en_passant;
+    next->captured_piece = move.capture_piece;
+    #if defined(NN_EVAL)
+        next->move = move;
+        next->accumulator_ready = false;
+    #endif
+    if(move.capture_piece != 255 || move.piece == (player*6)){
+        next->rule50 = 0;
+    }else{
+        next->rule50 = st->rule50 + 1;
+    }
+
+    Board<Magic>::do_move(board, move, player, next->castling_rights, next->en_passant, *zobrist_table, next->key);
+    Board<Magic>::move_occupancy(occupancy, move, player);
+    Board<Magic>::move_mailbox(mailbox, move, player);
+    st = next;
+    player = Color(player^1);
+    st->checkers = compute_checkers();
+}
+
+/// @brief Take back the last move made with do_move
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param move move to take back
+template <typename Magic>
+void Position<Magic>::undo_move(Move move){
+    assert(st > states);
+    player = Color(player^1);
+    Board<Magic>::undo_move(board, move, player);
+    Board<Magic>::move_occupancy(occupancy, move, player);
+    Board<Magic>::undo_mailbox(mailbox, move, player);
+    st--;
+}
+
+/// @brief Pass the turn, the en passant square is kept as the search always did for null moves
+/// @tparam Magic the type of magic the move generator is using, see config.h
+template <typename Magic>
+void Position<Magic>::do_null_move(){
+    assert(st - states < MAX_STATES - 1);
+    StateInfo *next = st + 1;
+    *next = *st;
+    next->key ^= (*zobrist_table)[zobrist_table->black_to_move];
+    next->captured_piece = 255;
+    #if defined(NN_EVAL)
+        next->move = Move();
+        next->accumulator_ready = false;
+    #endif
+    st = next;
+    player = Color(player^1);
+    st->checkers = compute_checkers();
+}
+
+/// @brief Take back a null move
+/// @tparam Magic the type of magic the move generator is using, see config.h
+template <typename Magic>
+void Position<Magic>::undo_null_move(){
+    assert(st > states);
+    player = Color(player^1);
+    st--;
+}
+
+/// @brief Check if the player to move is in check
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @return true if in check, false otherwise
+template <typename Magic>
+bool Position<Magic>::in_check(){
+    return st->checkers != 0;
+}
+
+#if defined(NN_EVAL)
+    /// @brief Get the first layer pre-activations of the current position, the states after the last evaluated one
+    /// are brought up to date with the moves that led to them, if no state was evaluated the current one is computed from scratch
+    /// @tparam Magic the type of magic the move generator is using, see config.h
+    /// @param evaluator evaluator of the thread using the position
+    /// @return accumulator of the current state
+    template <typename Magic>
+    AccType* Position<Magic>::nn_accumulator(Evaluator &evaluator){
+        StateInfo *s = st;
+        while(!s->accumulator_ready && s > states){
+            s--;
+        }
+        if(!s->accumulator_ready){
+            evaluator.nn_refresh(st->accumulator, board, st->castling_rights, st->en_passant, player);
+            st->accumulator_ready = true;
+            return st->accumulator;
+        }
+        Color color = Color(player ^ ((st - s) & 1));
+        for(; s < st; s++){
+            StateInfo *next = s + 1;
+            memcpy(next->accumulator, s->accumulator, 16*sizeof(AccType));
+            evaluator.nn_update(next->accumulator, next->move, color, s->castling_rights, next->castling_rights, s->en_passant, next->en_passant);
+            next->accumulator_ready = true;
+            color = Color(color^1);
+        }
+        return st->accumulator;
+    }
+#endif
+
+template class Position<PEXT_Magic>;
+template class Position<FIXED_Magic>;
+
+}
@@ -0,0 +1,65 @@
+#ifndef POSITION_H
+#define POSITION_H
+
+#include "types.h"
+#include "config.h"
+#include "zobrist.h"
+#include "move_generator.h"
+
+#define MAX_STATES 1024
+
+using namespace std;
+
+namespace arapaimachess{
+
+/// @brief Irreversible state of a position, one per ply so undo_move only has to step back
+struct StateInfo{
+    u64 key;
+    Bitboard checkers;
+    unsigned int rule50;
+    CastlingRights castling_rights;
+    u8 en_passant;
+    u8 captured_piece;
+    #if defined(NN_EVAL)
+        Move move;              // move that led to this state, from and to equal to 255 for a null move
+        bool accumulator_ready; // accumulator is only brought up to date when the position is evaluated
+        AccType accumulator[16];  // first layer pre-activations of the nn, see nn_refresh
+    #endif
+};
+
+template <typename Magic>
+class Position{
+    private:
+        Zobrist *zobrist_table;
+        MoveGenerator<Magic> *move_generator;
+        StateInfo states[MAX_STATES];
+
+        Bitboard compute_checkers();
+    public:
+        Bitboard board[12];
+        Bitboard occupancy[3];
+        u8 mailbox[64];
+        Color player;
+        StateInfo *st;
+
+        Position();
+        Position(Zobrist *zobrist_table, MoveGenerator<Magic> *move_generator);
+        Position(const Position &other);
+        ~Position() = default;
+
+        void set(Bitboard board[], Color player, CastlingRights cr, u8 ep, unsigned int rule50, u64 key);
+        
+        void do_move(Move move);
+        void undo_move(Move move);
+        void do_null_move();
+        void undo_null_move();
+
+        bool in_check();
+        #if defined(NN_EVAL)
+            AccType* nn_accumulator(Evaluator &evaluator);
+        #endif
+};
+
+}
+
+#endif
@@ -7,6 +7,8 @@
 #include "evaluate.h"
 #include "board.h"
 #include "utils.h"
+#include "./magics/pext.h"
+#include "./magics/fixed.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -21,70 +23,107 @@ using namespace std;
 namespace arapaimachess{
 
 /// @brief Create Search object
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param move_gen reference to MoveGenerator object
 /// @param zobrist_table reference to Zobrist object
-Search::Search(MoveGenerator<MAGIC> *move_gen, Zobrist *zobrist_table){
+template <typename Magic>
+Search<Magic>::Search(MoveGenerator<Magic> *move_gen, Zobrist *zobrist_table){
     assert(zobrist_table != NULL && move_gen != NULL);
     this->move_gen = move_gen;
     this->zobrist_table = zobrist_table;
 }
-Search::Search(){}
+template <typename Magic>
+Search<Magic>::Search(){}
 
-void Search::set_null_move(bool set){
+/// @brief Set the move generator used by this search, each search thread owns its own generator (and history)
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param move_gen reference to MoveGenerator object
+template <typename Magic>
+void Search<Magic>::set_move_generator(MoveGenerator<Magic> *move_gen){
+    assert(move_gen != NULL);
+    this->move_gen = move_gen;
+}
+
+/// @brief Set the counter the node count is published to while searching, used by the Lazy SMP helpers
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param counter counter read by the main thread, NULL to not publish
+template <typename Magic>
+void Search<Magic>::set_node_counter(atomic<u64> *counter){
+    this->node_counter = counter;
+}
+
+/// @brief Count a searched node, publishing the count every NODES_PUBLISH_INTERVAL nodes
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param nodes node counter
+template <typename Magic>
+void Search<Magic>::count_node(u64 &nodes){
+    nodes++;
+    if(this->node_counter != NULL && (nodes & (NODES_PUBLISH_INTERVAL - 1)) == 0){
+        this->node_counter->store(nodes, memory_order_relaxed);
+    }
+}
+
+/// @brief Clear the killer moves of every ply
+/// @tparam Magic the type of magic the move generator is using, see config.h
+template <typename Magic>
+void Search<Magic>::reset_killers(){
+    memset(this->killers, 0, MAX_PLY*2*sizeof(PackedMove));
+}
+
+/// @brief Add a quiet move that caused a beta cutoff as the first killer of its ply
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param ply distance from the root
+/// @param move move to add
+template <typename Magic>
+void Search<Magic>::add_killer(int ply, Move move){
+    PackedMove packed = pack_move(move);
+    if(this->killers[ply][0] != packed){
+        this->killers[ply][1] = this->killers[ply][0];
+        this->killers[ply][0] = packed;
+    }
+}
+
+template <typename Magic>
+void Search<Magic>::set_null_move(bool set){
     this->null_move = set;
 }
-void Search::set_late_move(bool set){
+template <typename Magic>
+void Search<Magic>::set_late_move(bool set){
     this->late_move = set;
 }
-void Search::set_futility(bool set){
+template <typename Magic>
+void Search<Magic>::set_futility(bool set){
     this->futility = set;
 }
-void Search::set_razoring(bool set){
+template <typename Magic>
+void Search<Magic>::set_razoring(bool set){
     this->razoring = set;
 }
 
 /// @brief Check if position is checkmate
-/// @param board array of bitboards
-/// @param player player to check if checkmated
-/// @param cr castling rights
-/// @param ep en passant square
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param pos position to check, the player to move is the one checked
 /// @return true if position is a checkmate, false otherwise
-bool Search::is_mate(Bitboard board[], Color player, CastlingRights cr, u8 ep){
-    Bitboard empty_pieces = 0;
-    for(int i = NO_PIECE; i < WHITE_KING; i++){
-        empty_pieces |= board[i];
-    }
-    empty_pieces = ~empty_pieces;
-    if(this->move_gen->in_check(board, empty_pieces, player) && this->move_gen->legal_moves(board, player, cr, ep).size() == 0){
-        return true;
-    }
-
-    return false;
+template <typename Magic>
+bool Search<Magic>::is_mate(Position<Magic> &pos){
+    return pos.in_check() && !this->move_gen->has_legal_move(pos);
 }
 
 /// @brief Check if position is stalemate
-/// @param board array of bitboards
-/// @param player player to check if stalemated
-/// @param cr castling rights
-/// @param ep en passant square
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param pos position to check, the player to move is the one checked
 /// @return true if position is a stalemate, false otherwise
-bool Search::is_stalemate(Bitboard board[], Color player, CastlingRights cr, u8 ep){
-    Bitboard empty_pieces = 0;
-    for(int i = NO_PIECE; i < WHITE_KING; i++){
-        empty_pieces |= board[i];
-    }
-    empty_pieces = ~empty_pieces;
-    if(!this->move_gen->in_check(board, empty_pieces, player) && this->move_gen->legal_moves(board, player, cr, ep).size() == 0){
-        return true;
-    }
-
-    return false;
+template <typename Magic>
+bool Search<Magic>::is_stalemate(Position<Magic> &pos){
+    return !pos.in_check() && !this->move_gen->has_legal_move(pos);
 }
 
 /// @brief Check if position is insufficient material
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param board array of bitboards
 /// @return true if material is insufficient, false otherwise
-bool Search::is_insufficient_material(Bitboard board[]){
+template <typename Magic>
+bool Search<Magic>::is_insufficient_material(Bitboard board[]){
     static u8 k_K[12] = {0,0,0,0,0,1, 0,0,0,0,0,1};
 
     static u8 k_KB[12] = {0,0,0,0,0,1, 0,0,1,0,0,1};
@@ -167,21 +206,20 @@ bool Search::is_insufficient_material(Bitboard board[]){
 }
 
 /// @brief Check if a position is terminal (checkmate, stalemate or insufficient material)
-/// @param board array of bitboards
-/// @param player player to check if stalemated
-/// @param cr castling rights
-/// @param ep en passant square
+/// @tparam Magic the type of magic the move generator is using, see config.h
+/// @param pos position to check
 /// @return true if the position is terminal, false otherwise
-bool Search::is_terminal(Bitboard board[], Color player, CastlingRights cr, u8 ep){
+template <typename Magic>
+bool Search<Magic>::is_terminal(Position<Magic> &pos){
     return (
-        is_mate(board, player, cr, ep) ||
-        is_stalemate(board, player, cr, ep) ||
-        is_insufficient_material(board)
+        is_mate(pos) ||
+        is_stalemate(pos) ||
+        is_insufficient_material(pos.board)
     );
 }
 
 /// @brief Search function using Negamax and Alpha-Beta framework
-/// @param rule50 rule 50 counter
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param stop flag to stop search when time is over
 /// @param pv principal variation line of search
 /// @param nodes node counter
@@ -189,21 +227,24 @@ bool Search::is_terminal(Bitboard board[], Color player, CastlingRights cr, u8 e
 /// @param depth current search depth
 /// @param alpha alpha limit
 /// @param beta beta limit
-/// @param board array of bitboards
-/// @param player current player
-/// @param cr castling rights
-/// @param en_passant en passant square
+/// @param pos position to search, moves are made and taken back on it
 /// @param tt reference to transposition table object
 /// @param search_moves moves to search in the first depth or moves to search at each depth
 /// @param search_order toggle between moves to search in the first depth and moves to search at each depth
 /// @param book_move force to search only the book move
 /// @return evaluation of the current position
-int Search::AlphaBeta(unsigned int rule50, atomic<bool> *stop, PVLine *pv, u64 &nodes, int max_depth, int depth, int alpha, int beta, Bitboard board[], Color player, CastlingRights cr, u8 en_passant, TT &tt, vector<Move> search_moves, bool search_order, bool book_move){
+template <typename Magic>
+int Search<Magic>::AlphaBeta(atomic<bool> *stop, PVLine *pv, u64 &nodes, int max_depth, int depth, int alpha, int beta, Position<Magic> &pos, TT &tt, PVLine *search_moves, bool search_order, bool book_move){
+    Bitboard *board = pos.board;
+    Color player = pos.player;
+    CastlingRights cr = pos.st->castling_rights;
+    u8 en_passant = pos.st->en_passant;
+    u64 key = pos.st->key;
     PVLine line;
     bool can_prune = max_depth != depth;
-    nodes++;
+    count_node(nodes);
 
-    if(TB_LARGEST == SYZYGY_PIECES && cr == NO_CASTLING && Board<MAGIC>::count_pieces(board) <= TB_LARGEST){
+    if(TB_LARGEST == SYZYGY_PIECES && cr == NO_CASTLING && Board<Magic>::count_pieces(board) <= TB_LARGEST){
         Bitboard white_pieces = 0;
         Bitboard black_pieces = 0;
         for(int i = 0; i < 6; i++){
@@ -231,14 +272,17 @@ int Search::AlphaBeta(unsigned int rule50, atomic<bool> *stop, PVLine *pv, u64 &
         return eval_wdl[TB_GET_WDL(res)];
     }
 
-    if(is_mate(board, player, cr, en_passant)){
-        return -(2147400001-(max_depth-depth));
-    }else if(is_stalemate(board, player, cr, en_passant) || is_insufficient_material(board) || rule50 >= 100){
+    int ply = max_depth-depth;
+    assert(ply >= 0 && ply < MAX_PLY);
+    // A mate given on the move that reaches the 50 move limit still counts, it needs a check to be one
+    if(is_insufficient_material(board)){
         return 0;
+    }else if(pos.st->rule50 >= 100){
+        return (pos.in_check() && !this->move_gen->has_legal_move(pos)) ? -(2147400001-ply) : 0;
     }
 
     if(depth <= 0){
-        int score = Quiesce(rule50, stop, nodes, alpha, beta, board, player, cr, en_passant, tt);
+        int score = Quiesce(stop, nodes, alpha, beta, pos, tt);
         if(score == 2147400001){
             score -= max_depth;
         }else if(score == -2147400001){
@@ -247,14 +291,15 @@ int Search::AlphaBeta(unsigned int rule50, atomic<bool> *stop, PVLine *pv, u64 &
         return score;
     }
 
-    Move hash_move;
+    // The move of an entry is tried first whatever its depth, the previous iteration stored it one ply shallower.
+    // Only the cutoffs need the entry to be as deep as this node
+    PackedMove hash_move;
     int alpha_orig = alpha;
-    u64 key = zob_key(*zobrist_table, board, player, cr, en_passant);
     Entry curr_entry = tt.atomic_read(key);
+    if(curr_entry.is_board_equal(key)){
+        hash_move = curr_entry.move;
+    }
     if(curr_entry.depth >= depth && curr_entry.is_board_equal(key)){
-        if(curr_entry.move.from != 255){
-            hash_move = curr_entry.move;
-        }
         hits++;
         if(can_prune){
             if(curr_entry.flag == TT_EXACT){
@@ -268,33 +313,32 @@ int Search::AlphaBeta(unsigned int rule50, atomic<bool> *stop, PVLine *pv, u64 &
             pv->argmove[0] = curr_entry.move;
             pv->flags[0] = 1;
             pv->eval[0] = curr_entry.eval;
-            memcpy(pv->argmove + 1, line.argmove, line.cmove * sizeof(Move));
+            memcpy(pv->argmove + 1, line.argmove, line.cmove * sizeof(PackedMove));
             memcpy(pv->eval + 1, line.eval, line.cmove * sizeof(int));
             pv->cmove = line.cmove + 1;
         }
     }
 
-    Bitboard board_copy[12];
+    // Mate and stalemate come after the TT cutoff and before any pruning, leaves are left to Quiesce.
+    // has_legal_move stops at the first legal move
+    if(!this->move_gen->has_legal_move(pos)){
+        return pos.in_check() ? -(2147400001-ply) : 0;
+    }
 
     // Null Move Pruning
     if(can_prune && !search_order && null_move && depth >= NULL_MOVE_DEPTH && !has_only_pawns(board, player)){
-        memcpy(board_copy, board, 12*sizeof(Bitboard));
-        CastlingRights cr_copy = cr;
-        u8 ep = en_passant;
-        Bitboard empty_pieces = 0;
-        for(int i = NO_PIECE; i < WHITE_KING; i++){
-            empty_pieces |= board_copy[i];
-        }
-        empty_pieces = ~empty_pieces;
         int reduction = NULL_REDUCTION;
         if(depth-reduction < NULL_MOVE_DEPTH){
             reduction = 0;
         }
-        if(!this->move_gen->in_check(board_copy, empty_pieces, player)){
+        if(!pos.in_check()){
             PVLine null_line;
+            pos.do_null_move();
+            tt.prefetch(pos.st->key);
             null_move = false;
-            int score = -AlphaBeta(rule50, stop, &null_line, nodes, max_depth, depth-1-reduction, -beta, -(beta-1), board_copy, Color(player^1), cr_copy, ep, tt, vector<Move>(), false, false);
+            int score = -AlphaBeta(stop, &null_line, nodes, max_depth, depth-1-reduction, -beta, -(beta-1), pos, tt, NULL, false, false);
             null_move = true;
+            pos.undo_null_move();
             if(score >= beta){
                 return beta;
             }
@@ -304,7 +348,7 @@ int Search::AlphaBeta(unsigned int rule50, atomic<bool> *stop, PVLine *pv, u64 &
     int eval = 0;
     if(can_prune && !search_order){
         #if defined(NN_EVAL)
-            eval = evaluate(board, cr, en_passant, player);
+            eval = evaluator.nn_evaluate(pos.nn_accumulator(evaluator));
         #else
             eval = evaluate(board, evaluation, 12, 6);
         #endif
@@ -313,7 +357,7 @@ int Search::AlphaBeta(unsigned int rule50, atomic<bool> *stop, PVLine *pv, u64 &
     // Razoring
     if(can_prune && !search_order && razoring){
         if(eval < alpha - 514 - 294 * depth * depth){
-            return Quiesce(rule50, stop, nodes, alpha, beta, board, player, cr, en_passant, tt);
+            return Quiesce(stop, nodes, alpha, beta, pos, tt);
         }
     }
 
@@ -328,60 +372,49 @@ int Search::AlphaBeta(unsigned int rule50, atomic<bool> *stop, PVLine *pv, u64 &
         }
     }
 
-    vector<Move> moves;
-    vector<Move> legal_moves = this->move_gen->legal_moves(board, player, cr, en_passant);
-    if(hash_move.from != 255){
-        auto it = find(legal_moves.begin(), legal_moves.end(), hash_move);
-        if(it != legal_moves.end()){
-            legal_moves.erase(it);
-            moves.push_back(hash_move);
-        }
-    }
-    if(search_moves.size() > 0){
-        if(book_move){
-            moves.push_back(search_moves[0]);
-        }else if(search_order){
-            Move pv_move = create_move(255, 255, 255, 255, 255, 255, 255);
-            if(max_depth-depth >= 0 && (size_t)(max_depth-depth) < search_moves.size()){
-                pv_move = search_moves[max_depth-depth];
+    MovePicker<Magic> picker(this->move_gen, &pos, hash_move, this->killers[ply]);
+    // The root and the pv hint keep the whole ordered list, the root list can be filtered by the book move or searchmoves
+    bool filtered = false;
+    if(search_moves != NULL && search_moves->cmove > 0){
+        MoveList &moves = picker.use_list();
+        this->move_gen->legal_moves(moves, pos);
+        if(book_move && moves.move_to_front(search_moves->argmove[0])){
+            moves.resize(1);
+            filtered = true;
+        }else{
+            if(!search_order){
+                filtered = true;
+                int size = 0;
+                for(Move move: moves){
+                    PackedMove packed = pack_move(move);
+                    for(int i = 0; i < search_moves->cmove; i++){
+                        if(search_moves->argmove[i] == packed){
+                            moves[size++] = move;
+                            break;
+                        }
+                    }
+                }
+                moves.resize(size);
             }
+            this->move_gen->order_moves(moves, player);
 
-            vector<Move> ordered = this->move_gen->order_moves(board, legal_moves, player, false);
-            moves.reserve(moves.size() + ordered.size());
-            if(pv_move.from != 255){
-                moves.push_back(pv_move);
-                auto it = find(ordered.begin(), ordered.end(), pv_move);
-                if(it != ordered.end()){
-                    ordered.erase(it);
-                }
+            if(search_order && ply < search_moves->cmove){
+                moves.move_to_front(search_moves->argmove[ply]);
+            }
+            if(!hash_move.empty()){
+                moves.move_to_front(hash_move);
             }
-            moves.insert(moves.end(), ordered.begin(), ordered.end());
-        }else{
-            vector<Move> ordered = this->move_gen->order_moves(board, search_moves, player, false);
-            moves.reserve(moves.size() + ordered.size());
-            moves.insert(moves.end(), ordered.begin(), ordered.end());
         }
-    }else{
-        vector<Move> ordered = this->move_gen->order_moves(board, legal_moves, player, false);
-        moves.insert(moves.end(), ordered.begin(), ordered.end());
     }
 
     bool first_move = true;
     bool stopped_search = false;
     int i = 0;
-    for(Move move: moves){
+    Move move;
+    while(picker.next_move(move)){
         line.cmove = 0;
-        memcpy(board_copy, board, 12*sizeof(Bitboard));
-        CastlingRights cr_copy = cr;
-        u8 ep = en_passant;
-
-        Board<MAGIC>::do_move(board_copy, move, player, cr_copy, ep);
-        
-        if(move.capture_piece != 255 || move.piece == (player*6)){
-            rule50 = 0;
-        }else{
-            rule50++;
-        }
+        pos.do_move(move);
+        tt.prefetch(pos.st->key);
 
         // Late Move Reduction/Pruning
         int reduction = 0;
@@ -391,20 +424,22 @@ int Search::AlphaBeta(unsigned int rule50, atomic<bool> *stop, PVLine *pv, u64 &
             reduction = (reduction > MAX_LATE_REDUCTION) ? MAX_LATE_REDUCTION : reduction;
         }
         i++;
-        int score = -AlphaBeta(rule50, stop, &line, nodes, max_depth, depth-1-reduction, -beta, -alpha, board_copy, Color(player^1), cr_copy, ep, tt, (first_move) ? search_moves : vector<Move>(), first_move, false);
+        int score = -AlphaBeta(stop, &line, nodes, max_depth, depth-1-reduction, -beta, -alpha, pos, tt, (first_move) ? search_moves : NULL, first_move, false);
+        pos.undo_move(move);
         first_move = false;
         
         if(score >= beta){
             if(move.capture_piece == 255){
                 this->move_gen->add_history(player, move, depth);
+                add_killer(ply, move);
             }
             return beta;
         }
         if(score > alpha){
             alpha = score;
-            pv->argmove[0] = move;
+            pv->argmove[0] = pack_move(move);
             pv->eval[0] = score;
-            memcpy(pv->argmove + 1, line.argmove, line.cmove * sizeof(Move));
+            memcpy(pv->argmove + 1, line.argmove, line.cmove * sizeof(PackedMove));
             memcpy(pv->eval + 1, line.eval, line.cmove * sizeof(int));
             pv->cmove = line.cmove + 1;
         }
@@ -415,6 +450,14 @@ int Search::AlphaBeta(unsigned int rule50, atomic<bool> *stop, PVLine *pv, u64 &
         }
     }
 
+    // Terminal nodes returned above, a filtered list with no move left says nothing about the position
+    if(i == 0){
+        if(filtered || ply == 0){
+            return alpha;
+        }
+        return pos.in_check() ? -(2147400001-ply) : 0;
+    }
+
     if(!stopped_search){
         TT_FLAGS flag = TT_EXACT;
         if(alpha <= alpha_orig){
@@ -430,70 +473,110 @@ int Search::AlphaBeta(unsigned int rule50, atomic<bool> *stop, PVLine *pv, u64 &
 }
 
 /// @brief Quiescence search function using Negamax framework
-/// @param rule50 rule 50 counter
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param stop flag to stop search when time is over
 /// @param nodes node counter
 /// @param alpha alpha limit
 /// @param beta beta limit
-/// @param board array of bitboards
-/// @param player current player
-/// @param cr castling rights
-/// @param en_passant en passant square
+/// @param pos position to search, moves are made and taken back on it
 /// @param tt reference to transposition table object
 /// @return evaluation of the position with quiescence search
-int Search::Quiesce(unsigned int rule50, atomic<bool> *stop, u64 &nodes, int alpha, int beta, Bitboard board[], Color player, CastlingRights cr, u8 en_passant, TT &tt){
-    nodes++;
-    if(is_mate(board, player, cr, en_passant)){
-        return -(2147400001);
-    }else if(is_stalemate(board, player, cr, en_passant) || is_insufficient_material(board) || rule50 >= 100){
+template <typename Magic>
+int Search<Magic>::Quiesce(atomic<bool> *stop, u64 &nodes, int alpha, int beta, Position<Magic> &pos, TT &tt){
+    Bitboard *board = pos.board;
+    Color player = pos.player;
+    u64 key = pos.st->key;
+    count_node(nodes);
+    if(pos.st->rule50 >= 100){
+        return (pos.in_check() && !move_gen->has_legal_move(pos)) ? -(2147400001) : 0;
+    }
+
+    // Quiescence entries are stored at depth 0, so any entry of the main search also cuts here.
+    // Mate and tablebase scores depend on the ply they were found at and are not reused
+    PackedMove hash_move;
+    Entry curr_entry = tt.atomic_read(key);
+    if(curr_entry.is_board_equal(key)){
+        hash_move = curr_entry.move;
+    }
+    if(curr_entry.depth >= 0 && curr_entry.is_board_equal(key)){
+        hits++;
+        if(abs(curr_entry.eval) < 2147400000){
+            if(curr_entry.flag == TT_EXACT){
+                return curr_entry.eval;
+            }else if(curr_entry.flag == TT_LOWER && curr_entry.eval >= beta){
+                return curr_entry.eval;
+            }else if(curr_entry.flag == TT_UPPER && curr_entry.eval <= alpha){
+                return curr_entry.eval;
+            }
+        }
+    }
+
+    // Without captures or checks the node is only terminal if no quiet move is legal either
+    MoveList moves;
+    move_gen->legal_moves(moves, pos, GEN_CAPTURES_CHECKS);
+    if(moves.size() == 0 && !move_gen->has_legal_move(pos)){
+        return pos.in_check() ? -(2147400001) : 0;
+    }else if(is_insufficient_material(board)){
         return 0;
     }
     #if defined(NN_EVAL)
-        int eval = evaluate(board, cr, en_passant, player) * (player == BLACK ? -1 : 1);
+        int eval = evaluator.nn_evaluate(pos.nn_accumulator(evaluator)) * (player == BLACK ? -1 : 1);
     #else
         int eval = evaluate(board, evaluation, 12, 6) * (player == BLACK ? -1 : 1);
     #endif
 
     if(eval >= beta){
+        tt.add(key, Entry(0, nodes, key, beta, TT_LOWER));
         return beta;
     }
+    int alpha_orig = alpha;
     if(eval > alpha){
         alpha = eval;
     }
 
-    Bitboard board_copy[12];
-    vector<Move> moves = move_gen->order_moves(board, move_gen->legal_moves(board, player, cr, en_passant), player, true);
+    move_gen->order_moves(moves, player);
+    if(!hash_move.empty()){
+        moves.move_to_front(hash_move);
+    }
+    PackedMove best_move;
     for(Move move : moves){
-        memcpy(board_copy, board, 12*sizeof(Bitboard));
-        CastlingRights cr_copy = cr;
-        u8 ep = en_passant;
-
         // Delta Pruning
         int delta = QUEEN_VALUE;
         if(move.promotion_piece != 255 && move.promotion_piece != 0){
             delta += QUEEN_VALUE-200;
         }
         if(eval < alpha - delta){
-            return alpha;
+            break;
         }
 
-        Board<MAGIC>::do_move(board_copy, move, player, cr_copy, ep);
+        pos.do_move(move);
+        tt.prefetch(pos.st->key);
 
-        int score = -Quiesce(rule50+1, stop, nodes, -beta, -alpha, board_copy, Color(player^1), cr_copy, ep, tt);
+        int score = -Quiesce(stop, nodes, -beta, -alpha, pos, tt);
+        pos.undo_move(move);
 
         if(score >= beta){
+            if(!stop->load(memory_order_relaxed) && abs(score) < 2147400000){
+                tt.add(key, Entry(0, nodes, key, beta, TT_LOWER, pack_move(move)));
+            }
             return beta;
         }
         if(score > alpha){
             alpha = score;
+            best_move = pack_move(move);
         }
         if(stop->load(memory_order_relaxed)){
             return alpha;
         }
     }
 
+    if(abs(alpha) < 2147400000){
+        tt.add(key, Entry(0, nodes, key, alpha, (alpha > alpha_orig) ? TT_EXACT : TT_UPPER, best_move));
+    }
     return alpha;
 }
 
+template class Search<PEXT_Magic>;
+template class Search<FIXED_Magic>;
 
-}
\ No newline at end of file
+}
@@ -4,11 +4,14 @@
 #include "types.h"
 #include "transposition_table.h"
 #include "move_generator.h"
+#include "move_picker.h"
+#include "position.h"
 #include "entry.h"
 #include "config.h"
 
 namespace arapaimachess{
 
+template <typename Magic>
 class Search{
     private:
         #if defined(MATERIAL_EVAL)
@@ -30,33 +33,46 @@ class Search{
                 KING_VALUE
             };
         #endif
-        MoveGenerator<MAGIC> *move_gen;
+        #if defined(NN_EVAL)
+            Evaluator evaluator;
+        #endif
+        MoveGenerator<Magic> *move_gen;
         Zobrist *zobrist_table;
 
-        bool null_move;
-        bool late_move;
-        bool futility;
-        bool razoring;
+        bool null_move = false;
+        bool late_move = false;
+        bool futility = false;
+        bool razoring = false;
+
+        PackedMove killers[MAX_PLY][2];
+        atomic<u64> *node_counter = NULL;
+
+        void count_node(u64 &nodes);
 
     public:
         int hits = 0;
-        Search(MoveGenerator<MAGIC> *move_gen, Zobrist *zobrist_table);
+        Search(MoveGenerator<Magic> *move_gen, Zobrist *zobrist_table);
         Search();
         ~Search() = default;
 
+        void set_move_generator(MoveGenerator<Magic> *move_gen);
+        void set_node_counter(atomic<u64> *counter);
+        void reset_killers();
+        void add_killer(int ply, Move move);
+
         void set_null_move(bool set);
         void set_late_move(bool set);
         void set_futility(bool set);
         void set_razoring(bool set);
 
-        bool is_mate(Bitboard board[], Color opp, CastlingRights cr, u8 ep);
-        bool is_stalemate(Bitboard board[], Color opp, CastlingRights cr, u8 ep);
+        bool is_mate(Position<Magic> &pos);
+        bool is_stalemate(Position<Magic> &pos);
         bool is_insufficient_material(Bitboard board[]);
-        bool is_terminal(Bitboard board[], Color opp, CastlingRights cr, u8 ep);
+        bool is_terminal(Position<Magic> &pos);
 
-        int AlphaBeta(unsigned int rule50, atomic<bool> *stop, PVLine *pv, u64 &nodes, int max_depth, int depth, int alpha, int beta, Bitboard board[], Color player, CastlingRights cr, u8 en_passant, TT &tt, vector<Move> search_moves, bool search_order, bool book_hint);
+        int AlphaBeta(atomic<bool> *stop, PVLine *pv, u64 &nodes, int max_depth, int depth, int alpha, int beta, Position<Magic> &pos, TT &tt, PVLine *search_moves, bool search_order, bool book_hint);
         
-        int Quiesce(unsigned int rule50, atomic<bool> *stop, u64 &nodes, int alpha, int beta, Bitboard board[], Color player, CastlingRights cr, u8 en_passant, TT &tt);
+        int Quiesce(atomic<bool> *stop, u64 &nodes, int alpha, int beta, Position<Magic> &pos, TT &tt);
 };
 
 }
@@ -1,76 +1,494 @@
 #include <cstring>
 #include <cstdlib>
 #include <atomic>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
 
 #include "transposition_table.h"
 #include "entry.h"
 
+#if defined(__linux__)
+    #include <sys/mman.h>
+#endif
+
 using namespace std;
 
 namespace arapaimachess{
 
+// Header layout - KKKK_KKKK_KKKK_----_----_----_GGGG_GGFF_DDDD_DDDD
+// K: upper 48 bits of the zobrist key, G: search generation, F: flag, D: depth + 1 (0 is an empty entry)
+#define TT_KEY_SHIFT 16
+#define TT_GENERATION_SHIFT 10
+#define TT_FLAG_SHIFT 8
+// Data layout - eval in the low 32 bits and the packed move above it
+#define TT_MOVE_SHIFT 32
+
+#define TT_GENERATION_MASK 63
+// Each search an entry has aged counts as this many plies of depth when picking a replacement
+#define TT_AGE_WEIGHT 8
+
+#define HUGE_PAGE_SIZE (2ULL*1024*1024)
+#define TT_PAGE_SIZE 4096ULL
+// Smallest table allocate falls back to, 1 MB
+#define TT_MIN_CLUSTERS 16384ULL
+
+#define TT_FILE_MAGIC "ARAPTT04"
+// Entries written or read at a time when saving and loading the table
+#define TT_FILE_CHUNK 65536
+
 TT::TT(){
-    this->table_size = 1048573;
-    this->entries = new atomic<Entry>[this->table_size];
+    this->allocate(1048576);
+    assert(this->clusters != NULL);
 }
 
-TT::TT(int size){
-    this->table_size = size;
-    this->entries = new atomic<Entry>[this->table_size];
+/// @brief Create a transposition table
+/// @param size size in number of entries, rounded down to a whole cluster
+TT::TT(u64 size){
+    this->allocate(size);
+    assert(this->clusters != NULL);
 }
 
 TT::~TT(){
-    delete[] this->entries;
-    this->entries = NULL;
+    this->release();
+}
+
+/// @brief Get the most clusters the table can use without running out of memory, the memory the table holds now
+/// counts as available since it is freed when the new table replaces it
+/// @return max amount of clusters
+u64 TT::max_clusters() const {
+    u64 available = 0;
+    #if defined(__linux__)
+        ifstream meminfo("/proc/meminfo");
+        string name;
+        u64 kb;
+        while(meminfo >> name >> kb){
+            if(name == "MemAvailable:"){
+                available = kb * 1024;
+                break;
+            }
+            meminfo.ignore(256, '\n');
+        }
+    #endif
+    if(available == 0){
+        return ~0ULL;
+    }
+    if(this->clusters != NULL){
+        available += this->num_clusters * sizeof(Cluster);
+    }
+    return available / 8 * 7 / sizeof(Cluster);
+}
+
+/// @brief Map zeroed memory for a given amount of clusters, with large pages try hugetlb pages first, then transparent huge pages, then calloc
+/// @param clusters amount of clusters
+/// @param memory allocated memory, to be freed by release
+/// @param memory_size size of the mapping, 0 if the memory came from calloc
+/// @param pages pages backing the memory
+/// @return first cluster, aligned to its size (or to a huge page), NULL if the memory could not be allocated
+Cluster *TT::map_clusters(u64 clusters, void *&memory, size_t &memory_size, TT_PAGES &pages) const {
+    size_t bytes = (size_t)clusters * sizeof(Cluster);
+    uintptr_t alignment = alignof(Cluster);
+
+    memory = NULL;
+    memory_size = 0;
+    pages = SMALL_PAGES;
+    #if defined(__linux__)
+        if(this->large_pages){
+            size_t huge_bytes = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+            void *mapped = mmap(NULL, huge_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if(mapped != MAP_FAILED){
+                pages = HUGETLB_PAGES;
+                memory_size = huge_bytes;
+            }else{
+                // Over allocate so the table can start at a huge page boundary
+                mapped = mmap(NULL, huge_bytes + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if(mapped != MAP_FAILED){
+                    memory_size = huge_bytes + HUGE_PAGE_SIZE;
+                    alignment = HUGE_PAGE_SIZE;
+                    void *start = (void *)(((uintptr_t)mapped + alignment - 1) & ~(alignment - 1));
+                    if(madvise(start, huge_bytes, MADV_HUGEPAGE) == 0){
+                        pages = TRANSPARENT_HUGE_PAGES;
+                    }
+                }
+            }
+            if(mapped != MAP_FAILED){
+                memory = mapped;
+            }
+        }
+    #endif
+    if(memory == NULL){
+        alignment = alignof(Cluster);
+        memory = calloc(bytes + alignment, 1);
+        if(memory == NULL){
+            return NULL;
+        }
+    }
+    return (Cluster *)(((uintptr_t)memory + alignment - 1) & ~(alignment - 1));
+}
+
+/// @brief Allocate the table, capped by the available memory and halved until the allocation succeeds.
+/// The current table is only replaced on success. Every path returns zeroed memory so the table starts clean
+/// @param size size in number of entries, rounded down to a whole cluster
+/// @return true if the table was allocated, false if not even TT_MIN_CLUSTERS could be allocated
+bool TT::allocate(u64 size){
+    u64 clusters = min(max(size / TT_CLUSTER_SIZE, 1ULL), this->max_clusters());
+    void *memory;
+    size_t memory_size;
+    TT_PAGES pages;
+    Cluster *start = this->map_clusters(clusters, memory, memory_size, pages);
+    while(start == NULL){
+        if(clusters <= TT_MIN_CLUSTERS){
+            return false;
+        }
+        clusters = max(clusters >> 1, TT_MIN_CLUSTERS);
+        start = this->map_clusters(clusters, memory, memory_size, pages);
+    }
+
+    this->replace_table(memory, memory_size, pages, start, clusters);
+    this->clean.store(true, memory_order_relaxed);
+    return true;
+}
+
+/// @brief Free the current table and use memory from map_clusters in its place, the pages are only touched up front
+/// when the table is new or grows
+/// @param memory memory returned by map_clusters
+/// @param memory_size size of the mapping returned by map_clusters
+/// @param pages pages backing the memory
+/// @param start first cluster returned by map_clusters
+/// @param clusters amount of clusters
+void TT::replace_table(void *memory, size_t memory_size, TT_PAGES pages, Cluster *start, u64 clusters){
+    bool grows = this->clusters == NULL || clusters > this->num_clusters;
+    this->release();
+    this->memory = memory;
+    this->memory_size = memory_size;
+    this->pages = pages;
+    this->clusters = start;
+    this->num_clusters = clusters;
+    this->table_size = clusters * TT_CLUSTER_SIZE;
+    if(grows){
+        this->prefault();
+    }
+}
+
+/// @brief Touch every page of a new table, splitting the pages across the configured threads.
+/// The kernel zeroes the pages in parallel here instead of faulting them one by one during the search
+void TT::prefault(){
+    u64 pages = (this->num_clusters * sizeof(Cluster) + TT_PAGE_SIZE - 1) / TT_PAGE_SIZE;
+    int threads = (int)min((u64)this->num_threads, pages);
+    volatile char *bytes = (volatile char *)this->clusters;
+    #pragma omp parallel for num_threads(threads)
+    for(int i = 0; i < threads; i++){
+        u64 start = pages * i / threads;
+        u64 end = pages * (i+1) / threads;
+        for(u64 page = start; page < end; page++){
+            bytes[page * TT_PAGE_SIZE] = 0;
+        }
+    }
+}
+
+/// @brief Free memory returned by map_clusters
+/// @param memory allocated memory
+/// @param memory_size size of the mapping, 0 if the memory came from calloc
+static void free_memory(void *memory, size_t memory_size){
+    #if defined(__linux__)
+        if(memory_size > 0){
+            munmap(memory, memory_size);
+            return;
+        }
+    #endif
+    (void)memory_size;
+    free(memory);
+}
+
+/// @brief Free the table memory
+void TT::release(){
+    free_memory(this->memory, this->memory_size);
+    this->memory = NULL;
+    this->memory_size = 0;
+    this->clusters = NULL;
+}
+
+/// @brief Toggle large pages, the table is allocated again if it changes
+/// @param set true to request huge pages
+void TT::set_large_pages(bool set){
+    if(this->large_pages == set){
+        return;
+    }
+    this->large_pages = set;
+    this->allocate(this->table_size);
+}
+
+/// @brief Get the size of the table
+/// @return size in MB
+u64 TT::get_MB(){
+    return (this->num_clusters * sizeof(Cluster)) >> 20;
+}
+
+/// @brief Get a description of the pages backing the table
+/// @return page size string
+string TT::get_page_info(){
+    if(this->pages == HUGETLB_PAGES){
+        return "2 MB pages (hugetlb)";
+    }else if(this->pages == TRANSPARENT_HUGE_PAGES){
+        return "2 MB pages (transparent huge pages)";
+    }
+    return "4 KB pages";
+}
+
+/// @brief Set the number of threads used to clear the table
+/// @param threads number of threads
+void TT::set_threads(int threads){
+    assert(threads > 0);
+    this->num_threads = threads;
+}
+
+/// @brief Get the cluster a key belongs to, the key is mapped to [0, num_clusters) with a multiply high so any cluster count
+/// can be used. The key is rotated first so the index comes from the low bits, which are not part of the key check
+/// @param key zobrist key
+/// @return reference to the cluster
+Cluster *TT::get_cluster(unsigned long long key) const {
+    u64 rotated = (key >> TT_KEY_SHIFT) | (key << (64 - TT_KEY_SHIFT));
+    return &this->clusters[(u64)(((unsigned __int128)rotated * this->num_clusters) >> 64)];
 }
 
-/// @brief Add an entry to the table
+/// @brief Prefetch the cluster of a key, called as soon as a child key is known so the probe does not stall
+/// @param key zobrist key
+void TT::prefetch(unsigned long long key) const {
+    __builtin_prefetch(get_cluster(key));
+}
+
+/// @brief Start a new search, entries from previous searches age and become easier to replace
+void TT::new_search(){
+    this->generation = (this->generation + 1) & TT_GENERATION_MASK;
+}
+
+/// @brief Pack the key check, generation, depth and flag of an entry
 /// @param key zobrist key
 /// @param entry entry object
-/// @return
-int TT::add(unsigned long long key, const Entry &entry){
-    int pos = key % this->table_size;
+/// @param generation current search generation
+/// @return header word
+u64 TT::pack_header(unsigned long long key, const Entry &entry, u8 generation){
+    return (
+        (key >> TT_KEY_SHIFT << TT_KEY_SHIFT) |
+        ((u64)(generation & TT_GENERATION_MASK) << TT_GENERATION_SHIFT) |
+        ((u64)(entry.flag & 3) << TT_FLAG_SHIFT) |
+        (u64)(u8)(entry.depth + 1)
+    );
+}
 
-    Entry curr_entry = this->entries[pos].load(memory_order_acquire);
+/// @brief Pack the payload of an entry, its eval and move
+/// @param entry entry object
+/// @return data word
+u64 TT::pack_data(const Entry &entry){
+    return (u64)(unsigned int)entry.eval | ((u64)entry.move.data << TT_MOVE_SHIFT);
+}
+
+/// @brief Unpack an entry from its header and data words
+/// @param key zobrist key the entry was found with
+/// @param header header word
+/// @param data data word
+/// @return entry object
+Entry TT::unpack(unsigned long long key, u64 header, u64 data){
+    Entry entry = Entry((int)(header & 255) - 1, 0, key);
+    entry.flag = TT_FLAGS((header >> TT_FLAG_SHIFT) & 3);
+    entry.eval = (int)(unsigned int)(data & 0xFFFFFFFFULL);
+    entry.move.data = (u16)(data >> TT_MOVE_SHIFT);
+    return entry;
+}
 
-    if(curr_entry.count < entry.count){
-        while(true){
-            if(this->entries[pos].compare_exchange_strong(curr_entry, entry, memory_order_acquire)){
-                return 0; 
+/// @brief Add an entry to the table, replacing the same position or the entry with the lowest depth minus age of the cluster
+/// @param key zobrist key
+/// @param entry entry object
+/// @return index of the replaced entry in the cluster, -1 if the entry was not stored
+int TT::add(unsigned long long key, const Entry &entry){
+    Cluster *cluster = get_cluster(key);
+    u64 key_check = key >> TT_KEY_SHIFT;
+
+    int replace = 0, replace_score = 2147483647;
+    for(int i = 0; i < TT_CLUSTER_SIZE; i++){
+        PackedEntry &slot = cluster->entries[i];
+        u64 data = slot.data.load(memory_order_relaxed);
+        u64 header = slot.key_data.load(memory_order_relaxed) ^ data;
+        int depth = (int)(header & 255) - 1;
+        int age = (this->generation - (header >> TT_GENERATION_SHIFT)) & TT_GENERATION_MASK;
+        if((header >> TT_KEY_SHIFT) == key_check){
+            // A shallower result never replaces the same position from this search, quiescence results
+            // (depth 0, often exact) would otherwise evict the main search entries
+            if(age == 0 && entry.depth < depth){
+                return -1;
             }
+            replace = i;
+            break;
+        }
+        int score = depth - TT_AGE_WEIGHT * age;
+        if(score < replace_score){
+            replace = i;
+            replace_score = score;
+        }
+    }
+
+    if(this->clean.load(memory_order_relaxed)){
+        this->clean.store(false, memory_order_relaxed);
+    }
+
+    u64 header = pack_header(key, entry, this->generation), data = pack_data(entry);
+    cluster->entries[replace].data.store(data, memory_order_relaxed);
+    cluster->entries[replace].key_data.store(header ^ data, memory_order_relaxed);
+    return replace;
+}
+
+/// @brief Read a value from the table without locking, a torn entry fails the key check and reads as a miss
+/// @param key zobrist key
+/// @return entry from the table, an empty entry (depth -1) if not found
+Entry TT::read(unsigned long long key) const {
+    Cluster *cluster = get_cluster(key);
+    u64 key_check = key >> TT_KEY_SHIFT;
+
+    for(int i = 0; i < TT_CLUSTER_SIZE; i++){
+        const PackedEntry &slot = cluster->entries[i];
+        u64 data = slot.data.load(memory_order_relaxed);
+        u64 header = slot.key_data.load(memory_order_relaxed) ^ data;
+        if((header >> TT_KEY_SHIFT) == key_check && (header & 255) != 0){
+            return unpack(key, header, data);
         }
     }
-    return 0;
+    return Entry();
 }
 
 /// @brief Atomically read a value from the table
 /// @param index zobrist key
 /// @return entry from the table
-Entry TT::atomic_read(unsigned long long index){ return this->entries[index % this->table_size].load(memory_order_acquire); }
+Entry TT::atomic_read(unsigned long long index){ return this->read(index); }
 
 /// @brief Reads a value from the table
 /// @param index zobrist key
 /// @return entry from the table
-Entry TT::operator[](unsigned long long index){ return this->entries[index % this->table_size]; }
+Entry TT::operator[](unsigned long long index){ return this->read(index); }
 
 /// @brief Reads a value from the table
 /// @param index zobrist key
 /// @return entry from the table
-const Entry TT::operator[](unsigned long long index) const { return this->entries[index % this->table_size]; }
+const Entry TT::operator[](unsigned long long index) const { return this->read(index); }
 
-/// @brief Clear the entire table
+/// @brief Clear the entire table, each thread zeroes its own slice, a table that was not written since it was allocated or cleared is skipped
 void TT::clear(){
-    for(int i = 0; i < table_size; i++){
-        this->entries[i] = Entry();
+    if(this->clean.load(memory_order_relaxed)){
+        return;
     }
+    int threads = (int)min((u64)this->num_threads, this->num_clusters);
+    #pragma omp parallel for num_threads(threads)
+    for(int i = 0; i < threads; i++){
+        u64 start = this->num_clusters * i / threads;
+        u64 end = this->num_clusters * (i+1) / threads;
+        memset((void *)(this->clusters + start), 0, (end - start) * sizeof(Cluster));
+    }
+    this->clean.store(true, memory_order_relaxed);
+}
+
+/// @brief Resize the table, the new memory comes zeroed so no clear is needed
+/// @param size new size in number of entries, rounded down to a whole cluster
+/// @return true if the table was resized, the current table is kept otherwise
+bool TT::resize(u64 size){
+    return this->allocate(size);
+}
+
+/// @brief Save the table to a file, the file is a header followed by the non empty entries only
+/// @param path path of the file
+/// @return true if the table was saved
+bool TT::save(string path){
+    ofstream output(path, ios::binary | ios::trunc);
+    if(!output.is_open()){
+        return false;
+    }
+    TTFileHeader header = {};
+    memcpy(header.magic, TT_FILE_MAGIC, sizeof(header.magic));
+    header.num_clusters = this->num_clusters;
+    header.generation = this->generation;
+    output.write((const char *)&header, sizeof(TTFileHeader));
+
+    TTFileEntry *buffer = new TTFileEntry[TT_FILE_CHUNK];
+    int buffered = 0;
+    for(u64 i = 0; i < this->table_size && output.good(); i++){
+        const PackedEntry &slot = this->clusters[i / TT_CLUSTER_SIZE].entries[i % TT_CLUSTER_SIZE];
+        u64 data = slot.data.load(memory_order_relaxed);
+        u64 key_data = slot.key_data.load(memory_order_relaxed);
+        if(((key_data ^ data) & 255) == 0){
+            continue;
+        }
+        buffer[buffered++] = {i, key_data, data};
+        header.num_entries++;
+        if(buffered == TT_FILE_CHUNK){
+            output.write((const char *)buffer, buffered * sizeof(TTFileEntry));
+            buffered = 0;
+        }
+    }
+    output.write((const char *)buffer, buffered * sizeof(TTFileEntry));
+    delete[] buffer;
+
+    // The entry count is only known at the end
+    output.seekp(0, ios::beg);
+    output.write((const char *)&header, sizeof(TTFileHeader));
+    return output.good();
 }
 
-/// @brief Resize the table
-/// @param size new size in number of entries
-void TT::resize(int size){
-    delete[] this->entries;
-    this->table_size = size;
-    this->entries = new atomic<Entry>[this->table_size];
+/// @brief Load a table saved by save, the table takes the saved size. The entries are read into a new table
+/// which only replaces the current one when the whole file was read and valid
+/// @param path path of the file
+/// @return true if the table was loaded
+bool TT::load(string path){
+    ifstream input(path, ios::binary);
+    if(!input.is_open()){
+        return false;
+    }
+    TTFileHeader header;
+    input.read((char *)&header, sizeof(TTFileHeader));
+    if(!input.good() || memcmp(header.magic, TT_FILE_MAGIC, sizeof(header.magic)) != 0 || header.num_clusters == 0 || header.num_clusters > this->max_clusters()){
+        return false;
+    }
+    u64 table_size = header.num_clusters * TT_CLUSTER_SIZE;
+    if(header.num_entries > table_size){
+        return false;
+    }
+    input.seekg(0, ios::end);
+    if((u64)input.tellg() != sizeof(TTFileHeader) + header.num_entries * sizeof(TTFileEntry)){
+        return false;
+    }
+    input.seekg(sizeof(TTFileHeader), ios::beg);
+
+    void *memory;
+    size_t memory_size;
+    TT_PAGES pages;
+    Cluster *start = this->map_clusters(header.num_clusters, memory, memory_size, pages);
+    if(start == NULL){
+        return false;
+    }
+
+    TTFileEntry *buffer = new TTFileEntry[TT_FILE_CHUNK];
+    bool valid = true;
+    for(u64 read = 0; read < header.num_entries && valid; read += TT_FILE_CHUNK){
+        int count = (int)min(header.num_entries - read, (u64)TT_FILE_CHUNK);
+        input.read((char *)buffer, count * sizeof(TTFileEntry));
+        valid = input.good();
+        for(int i = 0; i < count && valid; i++){
+            valid = buffer[i].index < table_size;
+            if(valid){
+                PackedEntry &slot = start[buffer[i].index / TT_CLUSTER_SIZE].entries[buffer[i].index % TT_CLUSTER_SIZE];
+                slot.key_data.store(buffer[i].key_data, memory_order_relaxed);
+                slot.data.store(buffer[i].data, memory_order_relaxed);
+            }
+        }
+    }
+    delete[] buffer;
+
+    if(!valid){
+        free_memory(memory, memory_size);
+        return false;
+    }
+    this->replace_table(memory, memory_size, pages, start, header.num_clusters);
+    this->generation = header.generation & TT_GENERATION_MASK;
+    this->clean.store(header.num_entries == 0, memory_order_relaxed);
+    return true;
 }
 
-}
\ No newline at end of file
+}
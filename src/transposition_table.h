@@ -2,28 +2,91 @@
 #define TT_H
 
 #include <atomic>
+#include <string>
 #include "entry.h"
 
+#define TT_CLUSTER_SIZE 4
+
 using namespace std;
 
 namespace arapaimachess{
 
+enum TT_PAGES: u8{
+    SMALL_PAGES = 0,
+    TRANSPARENT_HUGE_PAGES,
+    HUGETLB_PAGES
+};
+
+/// @brief Entry packed in two words, key_data holds the key xored with data so a torn write never passes the key check
+struct PackedEntry{
+    atomic<u64> key_data;
+    atomic<u64> data;
+};
+
+/// @brief Bucket of entries sharing the same index, sized to fit one cache line
+struct alignas(64) Cluster{
+    PackedEntry entries[TT_CLUSTER_SIZE];
+};
+
+/// @brief Header of a saved table, followed by num_entries TTFileEntry
+struct TTFileHeader{
+    char magic[8];
+    u64 num_clusters;
+    u64 generation;
+    u64 num_entries;
+};
+
+/// @brief Non empty entry of a saved table, index is the cluster times TT_CLUSTER_SIZE plus the slot in the cluster
+struct TTFileEntry{
+    u64 index;
+    u64 key_data;
+    u64 data;
+};
+
 class TT{
     private:
-        atomic<Entry> *entries = NULL;
-        int table_size;
+        void *memory = NULL;
+        size_t memory_size = 0;
+        TT_PAGES pages = SMALL_PAGES;
+        bool large_pages = false;
+        Cluster *clusters = NULL;
+        u64 table_size;
+        u64 num_clusters;
+        int num_threads = 1;
+        u8 generation = 0;
+        atomic<bool> clean;
+
+        u64 max_clusters() const;
+        Cluster *map_clusters(u64 clusters, void *&memory, size_t &memory_size, TT_PAGES &pages) const;
+        void replace_table(void *memory, size_t memory_size, TT_PAGES pages, Cluster *start, u64 clusters);
+        bool allocate(u64 size);
+        void release();
+        void prefault();
+        Cluster *get_cluster(unsigned long long key) const;
+        static u64 pack_header(unsigned long long key, const Entry &entry, u8 generation);
+        static u64 pack_data(const Entry &entry);
+        static Entry unpack(unsigned long long key, u64 header, u64 data);
+        Entry read(unsigned long long key) const;
     public:
         TT();
-        TT(int size);
+        TT(u64 size);
         ~TT();
         int add(unsigned long long key, const Entry &entry);
+        void prefetch(unsigned long long key) const;
+        void new_search();
+        void set_threads(int threads);
+        void set_large_pages(bool set);
+        string get_page_info();
+        u64 get_MB();
         Entry atomic_read(unsigned long long index);
         Entry operator[](unsigned long long index); 
         const Entry operator[](unsigned long long index) const;
         void clear();
-        void resize(int size);
+        bool resize(u64 size);
+        bool save(string path);
+        bool load(string path);
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -34,4 +34,25 @@ Move create_move(u8 from, u8 to, u8 piece, u8 capture_piece, u8 promotion_piece,
     move.set_en_passant(passant);
     move.set_castling(castling);
     return move;
-}
\ No newline at end of file
+}
+/// @brief Pack a move in 16 bits, an empty move (from 255) packs to an empty packed move
+/// @param move move to pack
+/// @return packed move
+PackedMove pack_move(Move move){
+    PackedMove packed;
+    if(move.from == 255){
+        return packed;
+    }
+    // Promotion first, a promotion is never castling or en passant whatever its flags hold
+    u16 special = NORMAL_MOVE, promotion = 0;
+    if(move.promotion_piece != 255 && move.promotion_piece != 0){
+        special = PROMOTION_MOVE;
+        promotion = move.promotion_piece - (KNIGHT - 1);
+    }else if(move.get_castling() != 0){
+        special = CASTLING_MOVE;
+    }else if(move.get_en_passant() != 0){
+        special = EN_PASSANT_MOVE;
+    }
+    packed.data = (move.from & 63) | ((move.to & 63) << 6) | (promotion << 12) | (special << 14);
+    return packed;
+}
@@ -3,7 +3,9 @@
 
 using i8 = signed char;
 using u8 = unsigned char;
+using i16 = short;
 using u16 = unsigned short;
+using i32 = int;
 using u64 = unsigned long long;
 using Bitboard = unsigned long long;
 
@@ -94,6 +96,13 @@ enum TT_FLAGS: u8{
     TT_UPPER
 };
 
+enum GenType: u8{
+    GEN_CAPTURES = 0, // captures, en passant and promotions
+    GEN_QUIETS,       // non captures without promotions, castling included
+    GEN_CAPTURES_CHECKS, // captures, en passant, promotions and non captures giving check, castling left out
+    GEN_ALL
+};
+
 // flags - CCEE_EEEE
 struct Move{
     u8 from = 255, to = 255;
@@ -122,6 +131,29 @@ struct Move{
     }
 };
 
+enum MoveSpecial: u8{
+    NORMAL_MOVE = 0,
+    PROMOTION_MOVE,
+    EN_PASSANT_MOVE,
+    CASTLING_MOVE
+};
+
+// Packed move - SSPP_TTTT_TTFF_FFFF
+// F: from square, T: to square, P: promotion piece - KNIGHT, S: special move (MoveSpecial)
+// Only what is needed to find the move again, piece and capture come from the position
+struct PackedMove{
+    u16 data = 0;
+
+    constexpr u8 get_from() const { return this->data & 63; }
+    constexpr u8 get_to() const { return (this->data >> 6) & 63; }
+    constexpr u8 get_promotion() const { return ((this->data >> 12) & 3) + KNIGHT - 1; }
+    constexpr u8 get_special() const { return this->data >> 14; }
+    constexpr bool empty() const { return this->data == 0; }
+
+    bool operator==(const PackedMove& other) const { return this->data == other.data; }
+    bool operator!=(const PackedMove& other) const { return this->data != other.data; }
+};
+
 Bitboard shift(Bitboard bb, int amount);
 
 CastlingRights operator|(CastlingRights a, CastlingRights b);
@@ -129,11 +161,51 @@ CastlingRights operator&(CastlingRights a, CastlingRights b);
 CastlingRights& operator|=(CastlingRights& a, CastlingRights b);
 
 Move create_move(u8 from, u8 to, u8 piece, u8 capture_piece, u8 promotion_piece, u8 passant, u8 castling);
+PackedMove pack_move(Move move);
+
+#define MAX_MOVES 256
+
+/// @brief Fixed capacity move list, lives on the stack so generating moves never touches the heap
+struct MoveList{
+    // Kept in a union so the moves are not default initialized every time a list is created
+    union{
+        Move moves[MAX_MOVES];
+    };
+    int count;
+
+    MoveList() : count(0) {}
+
+    void push_back(Move move) { this->moves[this->count++] = move; }
+    void clear() { this->count = 0; }
+    void resize(int size) { this->count = size; }
+    int size() const { return this->count; }
+
+    Move* begin() { return this->moves; }
+    Move* end() { return this->moves + this->count; }
+    Move& operator[](int i) { return this->moves[i]; }
+
+    /// @brief Move a given move to the start of the list, keeping the order of the others
+    /// @param move packed move to look for
+    /// @return true if the move was in the list, false otherwise
+    bool move_to_front(PackedMove move){
+        for(int i = 0; i < this->count; i++){
+            if(pack_move(this->moves[i]) == move){
+                Move found = this->moves[i];
+                for(; i > 0; i--){
+                    this->moves[i] = this->moves[i-1];
+                }
+                this->moves[0] = found;
+                return true;
+            }
+        }
+        return false;
+    }
+};
 
 struct PVLine{
     int cmove = 0;
     int eval[256] = {0};
-    Move argmove[256];
+    PackedMove argmove[256];
     u8 flags[256] = {0};
 };
 
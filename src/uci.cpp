@@ -4,6 +4,8 @@
 #include <cassert>
 #include <algorithm>
 #include "uci.h"
+#include "./magics/pext.h"
+#include "./magics/fixed.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -16,8 +18,10 @@ extern "C"{
 namespace arapaimachess{
 
 /// @brief Create a new UCI object with default opening book
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param engine reference to the Engine object
-UCI::UCI(Engine *engine){
+template <typename Magic>
+UCI<Magic>::UCI(Engine<Magic> *engine){
     assert(engine != NULL);
     this->engine = engine;
     this->book = new Book("./opening_book.txt", 914060149);
@@ -28,9 +32,11 @@ UCI::UCI(Engine *engine){
 }
 
 /// @brief Create a new UCI object
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param engine reference to the Engine object
 /// @param book reference to the opening Book object
-UCI::UCI(Engine *engine, Book *book){
+template <typename Magic>
+UCI<Magic>::UCI(Engine<Magic> *engine, Book *book){
     assert(engine != NULL && book != NULL);
     this->engine = engine;
     this->book = book;
@@ -40,16 +46,21 @@ UCI::UCI(Engine *engine, Book *book){
     }
 }
 
-UCI::~UCI(){
+template <typename Magic>
+UCI<Magic>::~UCI(){
     delete book;
     book = NULL;
 }
 
 thread go_thread;
 atomic<bool> going = false;
+// Set before the go thread starts and cleared when it returns, the search threads are done with the engine by then
+atomic<bool> search_running = false;
 
 /// @brief Read UCI command from stdin
-void UCI::read(){
+/// @tparam Magic the type of magic the move generator is using, see config.h
+template <typename Magic>
+void UCI<Magic>::read(){
     string token, cmd;
 
     is_start_pos = memcmp(start_pos, engine->board->board, 12*sizeof(Bitboard)) == 0;
@@ -68,11 +79,13 @@ void UCI::read(){
             if(going.load(memory_order_relaxed)){
                 going.store(false, memory_order_relaxed);
                 engine->stop_search.store(true, memory_order_relaxed);
-                engine->stoped_search.store(true, memory_order_relaxed);
             }
+            // Let the previous search finish so it does not share the engine with the new one
+            while(search_running.load(memory_order_acquire)){}
             if(!going.load(memory_order_relaxed)){
                 string args;
                 getline(is, args);
+                search_running.store(true, memory_order_relaxed);
                 go_thread = thread([this, args](){
                     go(args);
                 });
@@ -104,6 +117,27 @@ void UCI::read(){
             position(is);
         }else if(token == "d" || token == "display" || token == "print"){
             cout << engine->print_board();
+        }else if(token == "savehash" || token == "loadhash"){
+            string path;
+            getline(is >> ws, path);
+            // going is cleared by stop at once, the search threads keep using the table until the go thread returns
+            if(search_running.load(memory_order_acquire)){
+                cout << "info string Stop the search before " << token << '\n' << flush;
+            }else if(token == "savehash"){
+                cout << engine->save_hash(path) << flush;
+            }else{
+                cout << engine->load_hash(path) << flush;
+            }
+        }else if(token == "convertnn"){
+            #if defined(NN_EVAL)
+                string path, quantized_path;
+                is >> path >> quantized_path;
+                if(convert_nn(path, quantized_path)){
+                    cout << "info string Quantized " << path << " into " << quantized_path << '\n' << flush;
+                }else{
+                    cout << "info string Could not convert " << path << '\n' << flush;
+                }
+            #endif
         }else if(token == "move"){
             engine->pv.cmove = 0;
             is >> token;
@@ -115,8 +149,10 @@ void UCI::read(){
 }
 
 /// @brief Start go command, which starts search/perft from engine
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param args arguments of the go command
-void UCI::go(string args){
+template <typename Magic>
+void UCI<Magic>::go(string args){
     string token = "";
     int depth, wtime, btime, winc, binc, movetime;
     depth = wtime = btime = winc = binc = movetime = -1;
@@ -179,7 +215,9 @@ void UCI::go(string args){
         engine->nodes_count.store(0, memory_order_relaxed);
         engine->d.store(0, memory_order_relaxed);
         engine->pv_line = "";
+        // Both flags are set before the search thread starts, a stop sent right away is not lost and is waited for
         this->engine->stop_search.store(false, memory_order_relaxed);
+        this->engine->stoped_search.store(false, memory_order_relaxed);
 
         auto start = chrono::high_resolution_clock::now();
 
@@ -217,14 +255,15 @@ void UCI::go(string args){
 
         string move_string = "(none)";
         if(engine->pv.flags[0] != 2){
-            vector<Move> legal = engine->move_generator->order_moves(engine->board->board, engine->move_generator->legal_moves(engine->board->board, engine->board->curr_player, engine->board->castling_rights, engine->board->en_passant), engine->board->curr_player, false);
+            MoveList legal;
+            engine->move_generator->legal_moves(legal, engine->board->board, engine->board->curr_player, engine->board->castling_rights, engine->board->en_passant);
+            engine->move_generator->order_moves(legal, engine->board->curr_player);
             move_string = get_move_string(legal[0]);
-            Move engine_move = engine->pv.argmove[0];
+            PackedMove engine_move = engine->pv.argmove[0];
             auto it = find_if(legal.begin(), legal.end(), [&engine_move](const Move &move){
-                return move.from == engine_move.from && move.to == engine_move.to;
+                return move.from == engine_move.get_from() && move.to == engine_move.get_to();
             });
             if(it != legal.end()){
-                legal.erase(it);
                 move_string = get_move_string(engine->pv.argmove[0]);
             }else if(engine->last_move == get_move_string(engine->pv.argmove[1]) && get_move_string(engine->pv.argmove[2]).length()){
                 move_string = get_move_string(engine->pv.argmove[2]);
@@ -239,16 +278,18 @@ void UCI::go(string args){
         auto start = chrono::high_resolution_clock::now();
         u64 perft_nodes = this->engine->go_perft(depth);
         auto ellapsed = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - start).count();
-        this->engine->reset_search();
         cout << perft_nodes << " nodes found at depth = " << depth << " with time of " << ellapsed << " ms and " << (u64)((double)(perft_nodes)/(ellapsed*1e-3)) << " NPS\n" << flush;
     }
     engine->pv.cmove = 0;
     going.store(false, memory_order_relaxed);
+    search_running.store(false, memory_order_release);
 }
 
 /// @brief Process position command
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param stream stream containing arguments for the command
-void UCI::position(istringstream& stream){
+template <typename Magic>
+void UCI<Magic>::position(istringstream& stream){
     string token, fen;
     stream >> token;
     moves.clear();
@@ -279,11 +320,13 @@ void UCI::position(istringstream& stream){
 }
 
 /// @brief Process setoption command
+/// @tparam Magic the type of magic the move generator is using, see config.h
 /// @param stream stream containing arguments for the command
-void UCI::setoption(istringstream& stream){
+template <typename Magic>
+void UCI<Magic>::setoption(istringstream& stream){
     string token;
-    int threads, hash_size;
-    threads = hash_size = -1;
+    int threads = -1;
+    long long hash_size = -1;
     do{
         stream >> token;
 
@@ -295,12 +338,24 @@ void UCI::setoption(istringstream& stream){
         }else if(token == "Threads" || token == "threads"){
             stream >> token;
             stream >> threads;
-            engine->set_threads(threads);
+            threads = min(engine->threads_max, max(engine->threads_min, threads));
+            // The helpers are rebuilt, so the search threads must not be using them
+            if(search_running.load(memory_order_acquire)){
+                cout << "info string Stop the search before setting Threads\n" << flush;
+            }else{
+                engine->set_threads(threads);
+            }
         }else if(token == "Hash" || token == "hash"){
             stream >> token;
             stream >> hash_size;
-            hash_size = min(engine->hash_max, max(engine->hash_min, hash_size));
-            engine->set_hash(hash_size);
+            hash_size = min((long long)engine->hash_max, max((long long)engine->hash_min, hash_size));
+            cout << engine->set_hash(hash_size) << flush;
+        }else if(token == "LargePages" || token == "largepages"){
+            stream >> token;
+            if(token == "value")
+                stream >> token;
+            engine->set_large_pages((token == "true") ? true : false);
+            cout << engine->get_hash_info() << flush;
         }else if(token == "NullMove" || token == "nullmove"){
             stream >> token;
             if(token == "value")
@@ -356,4 +411,7 @@ void UCI::setoption(istringstream& stream){
     }while(!stream.eof());
 }
 
-}
\ No newline at end of file
+template class UCI<PEXT_Magic>;
+template class UCI<FIXED_Magic>;
+
+}
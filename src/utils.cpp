@@ -1,6 +1,7 @@
 #include "types.h"
 #include "zobrist.h"
 #include "entry.h"
+#include "transposition_table.h"
 #include <iostream>
 #include <vector>
 #include <cstring>
@@ -69,6 +70,21 @@ string get_move_string(Move move){
     return (move.from != 255 ? uci_move : "\0");
 }
 
+/// @brief Get the uci string of a packed move
+/// @param move packed move
+/// @return move in uci notation, empty for an empty move
+string get_move_string(PackedMove move){
+    static u8 pieces[6] = {0, 'n', 'b', 'r', 'q', 0};
+    if(move.empty()){
+        return "";
+    }
+    u8 from = move.get_from(), to = move.get_to();
+    char promo = move.get_special() == PROMOTION_MOVE ? pieces[move.get_promotion()] : '\0';
+    string sq1 = get_square(7-(from & 7), from >> 3), sq2 = get_square(7-(to & 7), to >> 3);
+    char uci_move[6] = {sq1[0], sq1[1], sq2[0], sq2[1], promo, '\0'};
+    return uci_move;
+}
+
 /// @brief Get move index from a uci move string
 /// @param move uci move string
 /// @return move index
@@ -83,7 +99,7 @@ u16 get_move_idx(string move){
 
 /// @brief print list of moves to stdin
 /// @param moves list of moves
-void print_moves(vector<Move> moves){
+void print_moves(MoveList &moves){
     for(Move move: moves){
         cout << get_move_string(move) << ' ';
     }
@@ -168,8 +184,8 @@ u64 read_hex(char *value){
 /// @brief Calculates how many entries to fill a given amount of MBs
 /// @param MB memory amount to use
 /// @return amount of entries
-int MB_to_TT(int MB){
-    return MB*1024*1024 / sizeof(Entry);
+u64 MB_to_TT(u64 MB){
+    return MB*1024*1024 / sizeof(PackedEntry);
 }
 
 /// @brief Check if a player has only pawns
@@ -27,8 +27,9 @@ string get_castling_rights(CastlingRights cr);
 u16 get_move_idx(string move);
 
 string get_move_string(Move move);
+string get_move_string(PackedMove move);
 
-void print_moves(vector<Move> moves);
+void print_moves(MoveList &moves);
 
 void print_bitboard(Bitboard board);
 
@@ -51,7 +52,7 @@ T char_to_bytes(char *value){
 
 u64 read_hex(char *value);
 
-int MB_to_TT(int MB);
+u64 MB_to_TT(u64 MB);
 
 bool has_only_pawns(Bitboard board[12], Color player);
 